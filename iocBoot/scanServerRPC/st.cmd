@@ -6,6 +6,16 @@ cd ${TOP}
 dbLoadDatabase("dbd/scanServerRPC.dbd")
 scanServerRPC_registerRecordDeviceDriver(pdbbase)
 
+## All scan records share one executor; set its worker count here
+#epicsEnvSet("SCAN_EXECUTOR_WORKERS","2")
+## Threads that run the record callbacks, apart from the workers
+#epicsEnvSet("SCAN_EXECUTOR_DISPATCHERS","1")
+## Scan log level: error, warn, info or debug
+#epicsEnvSet("SCAN_LOG_LEVEL","info")
+## Directory the dumpTrace request writes to; unset disables it
+#epicsEnvSet("SCAN_TRACE_DIR","/tmp")
+
 cd ${TOP}/iocBoot/${IOC}
 iocInit()
+## also creates the statistics record scanServerRPC:stats (latency histograms and step timing)
 scanServerRPCCreateRecord scanServerRPC
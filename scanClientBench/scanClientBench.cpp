@@ -0,0 +1,506 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Run the same workload against scanServerRPCMain and scanServerPutGetMain
+ * and compare the two transports.
+ * The workloads are configure with 10 to maxPoints points,
+ * start/stop loops, setRate bursts and setDebug bursts.
+ * The start/stop and setDebug loops carry no data, so they measure the
+ * request rate of the method dispatch itself.
+ * For each the round trip latency percentiles and the throughput are
+ * reported, together with how the mean round trip splits into
+ *   server   time the record spent serving the request, read from the
+ *            serviceTime histogram of <channelName>:stats
+ *   encode   time the client spent building the request
+ *   wire     the rest: serialization, network and pvAccess dispatch
+ * usage: scanClientBench [rpc|putget|both [maxPoints [iterations]]]
+ * Output is CSV.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <pv/pvaClient.h>
+
+using namespace std;
+using namespace epics::pvData;
+using namespace epics::pvAccess;
+using namespace epics::pvaClient;
+
+static StructureConstPtr makeRequestStructure()
+{
+    static StructureConstPtr requestStructure;
+    if (requestStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        requestStructure = fieldCreate->createFieldBuilder()->
+            add("method", pvString)->
+            createStructure();
+    }
+    return requestStructure;
+}
+
+static StructureConstPtr makePointStructure()
+{
+    static StructureConstPtr pointStructure;
+    if (pointStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        pointStructure = fieldCreate->createFieldBuilder()->
+            setId("point_t")->
+            add("x",pvDouble)->
+            add("y",pvDouble)->
+            createStructure();
+    }
+    return pointStructure;
+}
+
+static StructureConstPtr makeArgumentStructure()
+{
+    static StructureConstPtr argStructure;
+    if (argStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        argStructure = fieldCreate->createFieldBuilder()->
+            createStructure();
+    }
+    return argStructure;
+}
+
+static StructureConstPtr makeConfigureArgumentStructure()
+{
+    static StructureConstPtr argStructure;
+    if (argStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        argStructure = fieldCreate->createFieldBuilder()->
+            addArray("value", makePointStructure())->
+            createStructure();
+    }
+    return argStructure;
+}
+
+static StructureConstPtr makeSetRateArgumentStructure()
+{
+    static StructureConstPtr argStructure;
+    if (argStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+        argStructure = fieldCreate->createFieldBuilder()->
+            add("stepDelay",pvDouble)->
+            add("stepDistance",pvDouble)->
+            createStructure();
+    }
+    return argStructure;
+}
+
+static StructureConstPtr makeSetDebugArgumentStructure()
+{
+    static StructureConstPtr argStructure;
+    if (argStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+        argStructure = fieldCreate->createFieldBuilder()->
+            add("value",pvBoolean)->
+            createStructure();
+    }
+    return argStructure;
+}
+
+static double seconds(epicsUInt64 start)
+{
+    return (epicsMonotonicGet() - start)*1e-9;
+}
+
+/**
+ * The client side of one transport.
+ * Each command returns the time spent building the request.
+ */
+class Transport
+{
+public:
+    POINTER_DEFINITIONS(Transport);
+    Transport(PvaClientPtr const & pva,const string & channelName)
+    : channelName(channelName),
+      statsChannel(pva->channel(channelName + ":stats","pva",5.0))
+    {}
+    virtual ~Transport() {}
+    virtual string getName() = 0;
+    virtual double configure(const vector<double> & x,const vector<double> & y) = 0;
+    virtual double start() = 0;
+    virtual double stop() = 0;
+    virtual double setRate(double stepDelay,double stepDistance) = 0;
+    virtual double setDebug(bool value) = 0;
+    void resetStats() { putReset(true); }
+    /**
+     * Get the mean service time of the server since resetStats.
+     */
+    double getServerTime()
+    {
+        // processing the stats record refreshes it
+        putReset(false);
+        PvaClientGetPtr get(statsChannel->get("field(serviceTime)"));
+        get->get();
+        return get->getData()->getPVStructure()->
+            getSubField<PVDouble>("serviceTime.mean")->get();
+    }
+protected:
+    string channelName;
+private:
+    void putReset(bool value)
+    {
+        PvaClientPutPtr put(statsChannel->put("record[process=true]field(reset)"));
+        put->getData()->getPVStructure()->getSubField<PVBoolean>("reset")->put(value);
+        put->put();
+    }
+    PvaClientChannelPtr statsChannel;
+};
+
+class RPCTransport : public Transport
+{
+public:
+    RPCTransport(PvaClientPtr const & pva,const string & channelName)
+    : Transport(pva,channelName),
+      channel(pva->channel(channelName,"pva",5.0))
+    {}
+    virtual string getName() { return "rpc"; }
+    virtual double configure(const vector<double> & x,const vector<double> & y)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeConfigureArgumentStructure()));
+        PVStructureArray::svector values(x.size());
+        for(size_t i=0; i< x.size(); ++i)
+        {
+             PVStructurePtr point(getPVDataCreate()->createPVStructure(makePointStructure()));
+             point->getSubField<PVDouble>("x")->put(x[i]);
+             point->getSubField<PVDouble>("y")->put(y[i]);
+             values[i] = point;
+        }
+        pvArguments->getSubField<PVStructureArray>("value")->replace(freeze(values));
+        double encode = seconds(begin);
+        rpc("configure",pvArguments);
+        return encode;
+    }
+    virtual double start() { return command("start"); }
+    virtual double stop() { return command("stop"); }
+    virtual double setRate(double stepDelay,double stepDistance)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeSetRateArgumentStructure()));
+        pvArguments->getSubField<PVDouble>("stepDelay")->put(stepDelay);
+        pvArguments->getSubField<PVDouble>("stepDistance")->put(stepDistance);
+        double encode = seconds(begin);
+        rpc("setRate",pvArguments);
+        return encode;
+    }
+    virtual double setDebug(bool value)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeSetDebugArgumentStructure()));
+        pvArguments->getSubField<PVBoolean>("value")->put(value);
+        double encode = seconds(begin);
+        rpc("setDebug",pvArguments);
+        return encode;
+    }
+private:
+    double command(const string & method)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeArgumentStructure()));
+        double encode = seconds(begin);
+        rpc(method,pvArguments);
+        return encode;
+    }
+    void rpc(const string & method,PVStructurePtr const & pvArguments)
+    {
+        PVStructurePtr pvRequest =
+             getPVDataCreate()->createPVStructure(makeRequestStructure());
+        pvRequest->getSubFieldT<PVString>("method")->put(method);
+        channel->rpc(pvRequest,pvArguments);
+    }
+    PvaClientChannelPtr channel;
+};
+
+class PutGetTransport : public Transport
+{
+public:
+    PutGetTransport(PvaClientPtr const & pva,const string & channelName)
+    : Transport(pva,channelName),
+      channel(pva->channel(channelName,"pva",5.0)),
+      putGet(channel->createPutGet("putField(argument)getField(result)"))
+    {
+        putGet->connect();
+        PVStructurePtr pvStructure(putGet->getPutData()->getPVStructure());
+        pvCommand = pvStructure->getSubField<PVInt>("argument.command.index");
+        pvx = pvStructure->getSubField<PVDoubleArray>("argument.configArg.x");
+        pvy = pvStructure->getSubField<PVDoubleArray>("argument.configArg.y");
+        pvStepDelay = pvStructure->getSubField<PVDouble>("argument.rateArg.stepDelay");
+        pvStepDistance = pvStructure->getSubField<PVDouble>("argument.rateArg.stepDistance");
+        pvDebug = pvStructure->getSubField<PVBoolean>("argument.debugArg.value");
+        if(!pvCommand || !pvx || !pvy || !pvStepDelay || !pvStepDistance || !pvDebug) {
+            throw std::runtime_error(channelName + " does not have the argument fields");
+        }
+        // argument.command is an enum, look the indexes up once
+        PVStringArray::const_svector choices(channel->get("field(argument.command.choices)")->
+            getData()->getPVStructure()->getSubFieldT<PVStringArray>("argument.command.choices")->view());
+        commandConfigure = commandIndex(choices,"configure");
+        commandStart = commandIndex(choices,"start");
+        commandStop = commandIndex(choices,"stop");
+        commandSetRate = commandIndex(choices,"setRate");
+        commandSetDebug = commandIndex(choices,"setDebug");
+    }
+    virtual string getName() { return "putget"; }
+    virtual double configure(const vector<double> & x,const vector<double> & y)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        putGet->getPutData()->getChangedBitSet()->clear();
+        shared_vector<double> xvalues(x.size());
+        shared_vector<double> yvalues(y.size());
+        std::copy(x.begin(),x.end(),xvalues.begin());
+        std::copy(y.begin(),y.end(),yvalues.begin());
+        pvx->replace(freeze(xvalues));
+        pvy->replace(freeze(yvalues));
+        double encode = seconds(begin);
+        return encode + execute(commandConfigure);
+    }
+    virtual double start() { return clearAndExecute(commandStart); }
+    virtual double stop() { return clearAndExecute(commandStop); }
+    virtual double setRate(double stepDelay,double stepDistance)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        putGet->getPutData()->getChangedBitSet()->clear();
+        pvStepDelay->put(stepDelay);
+        pvStepDistance->put(stepDistance);
+        double encode = seconds(begin);
+        return encode + execute(commandSetRate);
+    }
+    virtual double setDebug(bool value)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        putGet->getPutData()->getChangedBitSet()->clear();
+        pvDebug->put(value);
+        double encode = seconds(begin);
+        return encode + execute(commandSetDebug);
+    }
+private:
+    static int commandIndex(PVStringArray::const_svector const & choices,const string & command)
+    {
+        for(size_t i=0; i<choices.size(); ++i) {
+            if(choices[i]==command) return static_cast<int>(i);
+        }
+        throw std::runtime_error("server has no command " + command);
+    }
+    double clearAndExecute(int command)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        putGet->getPutData()->getChangedBitSet()->clear();
+        double encode = seconds(begin);
+        return encode + execute(command);
+    }
+    double execute(int command)
+    {
+        epicsUInt64 begin = epicsMonotonicGet();
+        pvCommand->put(command);
+        double encode = seconds(begin);
+        putGet->putGet();
+        string result(putGet->getGetData()->getPVStructure()->
+            getSubField<PVString>("result.value")->get());
+        if(result.find("exception")==0) throw std::runtime_error(result);
+        return encode;
+    }
+    PvaClientChannelPtr channel;
+    PvaClientPutGetPtr putGet;
+    PVIntPtr pvCommand;
+    int commandConfigure;
+    int commandStart;
+    int commandStop;
+    int commandSetRate;
+    int commandSetDebug;
+    PVDoubleArrayPtr pvx;
+    PVDoubleArrayPtr pvy;
+    PVDoublePtr pvStepDelay;
+    PVDoublePtr pvStepDistance;
+    PVBooleanPtr pvDebug;
+};
+
+/**
+ * Round trip times of one workload.
+ */
+class Samples
+{
+public:
+    Samples() : encode(0.0), elapsed(0.0) {}
+    void add(double roundTrip,double encodeTime)
+    {
+        roundTrips.push_back(roundTrip);
+        encode += encodeTime;
+    }
+    double percentile(double value)
+    {
+        if(roundTrips.empty()) return 0.0;
+        vector<double> sorted(roundTrips);
+        sort(sorted.begin(),sorted.end());
+        size_t index = static_cast<size_t>(value/100.0*(sorted.size() - 1) + .5);
+        return sorted[index];
+    }
+    double mean()
+    {
+        double sum = 0.0;
+        for(size_t i=0; i<roundTrips.size(); ++i) sum += roundTrips[i];
+        return roundTrips.empty() ? 0.0 : sum/roundTrips.size();
+    }
+    vector<double> roundTrips;
+    double encode;
+    double elapsed;
+};
+
+static void report(Transport & transport,const string & workload,
+    size_t npoints,Samples & samples,double server)
+{
+    size_t ops = samples.roundTrips.size();
+    double mean = samples.mean();
+    double encode = ops ? samples.encode/ops : 0.0;
+    cout << transport.getName() << "," << workload << "," << npoints << ","
+         << ops << ","
+         << samples.percentile(50.0) << ","
+         << samples.percentile(90.0) << ","
+         << samples.percentile(99.0) << ","
+         << samples.percentile(100.0) << ","
+         << ops/samples.elapsed << ","
+         << ops*npoints/samples.elapsed << ","
+         << mean << "," << server << "," << encode << ","
+         << mean - server - encode << "\n";
+}
+
+static void runConfigure(Transport & transport,size_t maxPoints)
+{
+    for(size_t npoints=10; npoints<=maxPoints; npoints*=10)
+    {
+        vector<double> x(npoints);
+        vector<double> y(npoints);
+        for(size_t i=0; i<npoints; ++i)
+        {
+            x[i] = (i%1000)*.001;
+            y[i] = (i/1000)*.001;
+        }
+        size_t repeat = std::max<size_t>(3,std::min<size_t>(100,1000000/npoints));
+        Samples samples;
+        transport.resetStats();
+        epicsUInt64 begin = epicsMonotonicGet();
+        for(size_t i=0; i<repeat; ++i)
+        {
+            epicsUInt64 start = epicsMonotonicGet();
+            double encode = transport.configure(x,y);
+            samples.add(seconds(start),encode);
+        }
+        samples.elapsed = seconds(begin);
+        report(transport,"configure",npoints,samples,transport.getServerTime());
+    }
+}
+
+static void runStartStop(Transport & transport,size_t iterations)
+{
+    vector<double> x(1,0.0);
+    vector<double> y(1,0.0);
+    transport.configure(x,y);
+    transport.setRate(.1,.01);
+    Samples samples;
+    transport.resetStats();
+    epicsUInt64 begin = epicsMonotonicGet();
+    for(size_t i=0; i<iterations; ++i)
+    {
+        epicsUInt64 start = epicsMonotonicGet();
+        double encode = transport.start();
+        samples.add(seconds(start),encode);
+        start = epicsMonotonicGet();
+        encode = transport.stop();
+        samples.add(seconds(start),encode);
+    }
+    samples.elapsed = seconds(begin);
+    report(transport,"startStop",0,samples,transport.getServerTime());
+}
+
+static void runSetRate(Transport & transport,size_t iterations)
+{
+    Samples samples;
+    transport.resetStats();
+    epicsUInt64 begin = epicsMonotonicGet();
+    for(size_t i=0; i<iterations; ++i)
+    {
+        epicsUInt64 start = epicsMonotonicGet();
+        double encode = transport.setRate(.1 + (i%10)*.01,.01);
+        samples.add(seconds(start),encode);
+    }
+    samples.elapsed = seconds(begin);
+    report(transport,"setRate",0,samples,transport.getServerTime());
+}
+
+static void runSetDebug(Transport & transport,size_t iterations)
+{
+    Samples samples;
+    transport.resetStats();
+    epicsUInt64 begin = epicsMonotonicGet();
+    for(size_t i=0; i<iterations; ++i)
+    {
+        epicsUInt64 start = epicsMonotonicGet();
+        double encode = transport.setDebug(false);
+        samples.add(seconds(start),encode);
+    }
+    samples.elapsed = seconds(begin);
+    report(transport,"setDebug",0,samples,transport.getServerTime());
+}
+
+static void run(Transport & transport,size_t maxPoints,size_t iterations)
+{
+    runConfigure(transport,maxPoints);
+    runStartStop(transport,iterations);
+    runSetRate(transport,iterations);
+    runSetDebug(transport,iterations);
+}
+
+int main(int argc,char *argv[])
+{
+    string which = (argc>1) ? argv[1] : "both";
+    size_t maxPoints = (argc>2) ? atol(argv[2]) : 1000000;
+    size_t iterations = (argc>3) ? atol(argv[3]) : 1000;
+    if(which!="rpc" && which!="putget" && which!="both") {
+        cout << "usage: scanClientBench [rpc|putget|both [maxPoints [iterations]]]\n";
+        return 1;
+    }
+    try {
+        PvaClientPtr pva = PvaClient::get("pva");
+        cout << "transport,workload,points,ops,p50,p90,p99,max,"
+             << "opsPerSecond,pointsPerSecond,mean,server,encode,wire\n";
+        if(which!="putget") {
+            RPCTransport transport(pva,"scanServerRPC");
+            run(transport,maxPoints,iterations);
+        }
+        if(which!="rpc") {
+            PutGetTransport transport(pva,"scanServerPutGet");
+            run(transport,maxPoints,iterations);
+        }
+    } catch (std::exception& e) {
+        cerr << "exception " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
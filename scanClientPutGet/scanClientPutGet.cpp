@@ -33,6 +33,7 @@ private:
 
     PvaClientChannelPtr pvaClientChannel;
     PvaClientPutGetPtr pvaClientPutGet;
+    vector<string> commandChoices;
 
     void init(PvaClientPtr const &pvaClient)
     {
@@ -76,6 +77,22 @@ public:
         }
     }
 
+    // argument.command is an enum; its choices are read once from the record
+    int getCommandIndex(const string & command)
+    {
+        if(commandChoices.empty()) {
+            PVStructurePtr pvStructure(pvaClientChannel->get(
+                "field(argument.command.choices)")->getData()->getPVStructure());
+            PVStringArray::const_svector choices(
+                pvStructure->getSubFieldT<PVStringArray>("argument.command.choices")->view());
+            commandChoices.assign(choices.begin(),choices.end());
+        }
+        for(size_t i=0; i<commandChoices.size(); ++i) {
+            if(commandChoices[i]==command) return static_cast<int>(i);
+        }
+        throw std::runtime_error(channelName + " has no command " + command);
+    }
+
     void putGetConfigure(const string & input)
     {
         if(!channelConnected) {
@@ -121,9 +138,9 @@ public:
         convert->fromStringArray(pvx,0,npts,x,0);        
         pvy->setLength(npts);
         convert->fromStringArray(pvy,0,npts,y,0);    
-        PVStringPtr pvCommand(pvStructure->getSubField<PVString>("argument.command"));
-        if(!pvCommand) throw std::runtime_error("argument.command not found");
-        pvCommand->put("configure");
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("configure"));
         pvaClientPutGet->putGet();
         PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
         cout << getData->getPVStructure() << endl;
@@ -138,9 +155,9 @@ public:
         PvaClientPutDataPtr putData = pvaClientPutGet->getPutData();
         putData->getChangedBitSet()->clear();
         PVStructurePtr pvStructure = putData->getPVStructure();
-        PVStringPtr pvCommand(pvStructure->getSubField<PVString>("argument.command"));
-        if(!pvCommand) throw std::runtime_error("argument.command not found");
-        pvCommand->put("start");
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("start"));
         pvaClientPutGet->putGet();
         PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
         cout << getData->getPVStructure() << endl;
@@ -155,9 +172,26 @@ public:
         PvaClientPutDataPtr putData = pvaClientPutGet->getPutData();
         putData->getChangedBitSet()->clear();
         PVStructurePtr pvStructure = putData->getPVStructure();
-        PVStringPtr pvCommand(pvStructure->getSubField<PVString>("argument.command"));
-        if(!pvCommand) throw std::runtime_error("argument.command not found");
-        pvCommand->put("stop");
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("stop"));
+        pvaClientPutGet->putGet();
+        PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
+        cout << getData->getPVStructure() << endl;
+    }
+
+    void putGetStatus()
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        PvaClientPutDataPtr putData = pvaClientPutGet->getPutData();
+        putData->getChangedBitSet()->clear();
+        PVStructurePtr pvStructure = putData->getPVStructure();
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("status"));
         pvaClientPutGet->putGet();
         PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
         cout << getData->getPVStructure() << endl;
@@ -178,9 +212,9 @@ public:
         if(!pvStepDistance) throw std::runtime_error("argument.rateArg.stepDistance not found");
         pvStepDelay->put(stepDelay);
         pvStepDistance->put(stepDistance);
-        PVStringPtr pvCommand(pvStructure->getSubField<PVString>("argument.command"));
-        if(!pvCommand) throw std::runtime_error("argument.command not found");
-        pvCommand->put("setRate");
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("setRate"));
         pvaClientPutGet->putGet();
         PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
         cout << getData->getPVStructure() << endl;
@@ -198,9 +232,29 @@ public:
         PVBooleanPtr pvDebug(pvStructure->getSubField<PVBoolean>("argument.debugArg.value"));
         if(!pvDebug) throw std::runtime_error("argument.debugArg.value not found");
         pvDebug->put(value);
-        PVStringPtr pvCommand(pvStructure->getSubField<PVString>("argument.command"));
-        if(!pvCommand) throw std::runtime_error("argument.command not found");
-        pvCommand->put("setDebug");
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("setDebug"));
+        pvaClientPutGet->putGet();
+        PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
+        cout << getData->getPVStructure() << endl;
+    }
+
+    void putGetSetPublishRate(double rate)
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        PvaClientPutDataPtr putData = pvaClientPutGet->getPutData();
+        putData->getChangedBitSet()->clear();
+        PVStructurePtr pvStructure = putData->getPVStructure();
+        PVDoublePtr pvRate(pvStructure->getSubField<PVDouble>("argument.publishArg.rate"));
+        if(!pvRate) throw std::runtime_error("argument.publishArg.rate not found");
+        pvRate->put(rate);
+        PVIntPtr pvCommand(pvStructure->getSubField<PVInt>("argument.command.index"));
+        if(!pvCommand) throw std::runtime_error("argument.command.index not found");
+        pvCommand->put(getCommandIndex("setPublishRate"));
         pvaClientPutGet->putGet();
         PvaClientGetDataPtr getData = pvaClientPutGet->getGetData();
         cout << getData->getPVStructure() << endl;
@@ -218,6 +272,8 @@ static void help()
     cout << "   stop\n";
     cout << "   setRate stepDelay stepDistance\n";
     cout << "   setDebug true|false\n";
+    cout << "   setPublishRate rate (Hz, 0 publishes every step)\n";
+    cout << "   status\n";
 }
 
 int main(int argc,char *argv[])
@@ -257,6 +313,8 @@ int main(int argc,char *argv[])
                  clientPutGet->putGetStart();
             } else if(command=="stop") {
                  clientPutGet->putGetStop();
+            } else if(command=="status") {
+                 clientPutGet->putGetStatus();
             } else if(command=="setRate") {
                  if(argc!=4) throw std::runtime_error("illegal number of arguments");
                  double stepDelay = stod(argv[2]);
@@ -267,6 +325,9 @@ int main(int argc,char *argv[])
                  string sval = argv[2];
                  bool value = (sval=="true" ? "true" : "false");
                  clientPutGet->putGetSetDebug(value);
+            } else if(command=="setPublishRate") {
+                 if(argc!=3) throw std::runtime_error("illegal number of arguments");
+                 clientPutGet->putGetSetPublishRate(stod(argv[2]));
             } else {
                 cout << "unknown command\n";
             }
@@ -103,6 +103,19 @@ static StructureConstPtr makeSetDebugArgumentStructure()
     return argStructure;
 }
 
+static StructureConstPtr makeSetPublishRateArgumentStructure()
+{
+    static StructureConstPtr argStructure;
+    if (argStructure.get() == 0)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+        argStructure = fieldCreate->createFieldBuilder()->
+            add("value",pvDouble)->
+            createStructure();
+    }
+    return argStructure;
+}
+
 
 
 class ClientRPC;
@@ -156,12 +169,8 @@ public:
         channelConnected = isConnected;
     }
 
-    void commandConfigure(const string & input)
+    bool parsePoints(const string & input,vector<string> & x,vector<string> & y)
     {
-        if(!channelConnected) {
-            cout << channelName << " channel not connected\n";
-            return;
-        }
         vector<string> strvalues;
         size_t pos = 0;
         size_t n = 1;
@@ -179,16 +188,94 @@ public:
         size_t npts = n/2;
         if(npts*2 != n) {
             cout << "failure: odd number of points\n";
-            return;
+            return false;
         }
-        vector<string> x(npts);
-        vector<string> y(npts);
+        x.resize(npts);
+        y.resize(npts);
         size_t ind = 0;
         for(size_t i= 0; i < npts; ++i)
         {
              x[i] = strvalues[ind++];
              y[i] = strvalues[ind++];
         }
+        return true;
+    }
+
+    // configure, setRate and start in one round trip
+    void commandRun(double stepDelay,double stepDistance,const string & input)
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        vector<string> x;
+        vector<string> y;
+        if(!parsePoints(input,x,y)) return;
+        FieldCreatePtr fieldCreate = getFieldCreate();
+        PVDataCreatePtr pvDataCreate = getPVDataCreate();
+        PVUnionArray::svector commands;
+
+        PVStructurePtr configure(pvDataCreate->createPVStructure(
+            fieldCreate->createFieldBuilder()->
+                add("method",pvString)->
+                addArray("x",pvDouble)->
+                addArray("y",pvDouble)->
+                createStructure()));
+        configure->getSubField<PVString>("method")->put("configure");
+        shared_vector<double> xvalues(x.size());
+        shared_vector<double> yvalues(y.size());
+        for(size_t i=0; i< x.size(); ++i)
+        {
+             xvalues[i] = stod(x[i]);
+             yvalues[i] = stod(y[i]);
+        }
+        configure->getSubField<PVDoubleArray>("x")->replace(freeze(xvalues));
+        configure->getSubField<PVDoubleArray>("y")->replace(freeze(yvalues));
+        commands.push_back(pvDataCreate->createPVVariantUnion());
+        commands.back()->set(configure);
+
+        PVStructurePtr setRate(pvDataCreate->createPVStructure(
+            fieldCreate->createFieldBuilder()->
+                add("method",pvString)->
+                add("stepDelay",pvDouble)->
+                add("stepDistance",pvDouble)->
+                createStructure()));
+        setRate->getSubField<PVString>("method")->put("setRate");
+        setRate->getSubField<PVDouble>("stepDelay")->put(stepDelay);
+        setRate->getSubField<PVDouble>("stepDistance")->put(stepDistance);
+        commands.push_back(pvDataCreate->createPVVariantUnion());
+        commands.back()->set(setRate);
+
+        PVStructurePtr start(pvDataCreate->createPVStructure(
+            fieldCreate->createFieldBuilder()->
+                add("method",pvString)->
+                createStructure()));
+        start->getSubField<PVString>("method")->put("start");
+        commands.push_back(pvDataCreate->createPVVariantUnion());
+        commands.back()->set(start);
+
+        PVStructurePtr pvArguments(pvDataCreate->createPVStructure(
+            fieldCreate->createFieldBuilder()->
+                addArray("commands",fieldCreate->createVariantUnion())->
+                createStructure()));
+        pvArguments->getSubField<PVUnionArray>("commands")->replace(freeze(commands));
+        PVStructurePtr pvRequest = 
+             pvDataCreate->createPVStructure(makeRequestStructure());
+        pvRequest->getSubFieldT<PVString>("method")->put("batch");
+        PVStructurePtr response(pvaClientChannel->rpc(pvRequest,pvArguments));
+        cout << "response\n" << response << "\n";
+    }
+
+    void commandConfigure(const string & input)
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        vector<string> x;
+        vector<string> y;
+        if(!parsePoints(input,x,y)) return;
+        size_t npts = x.size();
         PVStructurePtr pvArguments(
              getPVDataCreate()->createPVStructure(
                  makeConfigureArgumentStructure()));
@@ -240,6 +327,41 @@ public:
         cout << "response\n" << response << "\n";       
     }
 
+    void commandStatus()
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeArgumentStructure()));
+        PVStructurePtr pvRequest = 
+             getPVDataCreate()->createPVStructure(makeRequestStructure());
+        pvRequest->getSubFieldT<PVString>("method")->put("status");
+        PVStructurePtr response(pvaClientChannel->rpc(pvRequest,pvArguments));
+        cout << "response\n" << response << "\n";       
+    }
+
+    void commandWaitComplete()
+    {
+        if(!channelConnected) {
+            cout << channelName << " channel not connected\n";
+            return;
+        }
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeArgumentStructure()));
+        PVStructurePtr pvRequest = 
+             getPVDataCreate()->createPVStructure(makeRequestStructure());
+        pvRequest->getSubFieldT<PVString>("method")->put("waitComplete");
+        PvaClientRPCPtr rpc(pvaClientChannel->createRPC(pvRequest));
+        // a scan can last much longer than the default response timeout
+        rpc->setResponseTimeout(24*3600.0);
+        PVStructurePtr response(rpc->request(pvArguments));
+        cout << "response\n" << response << "\n";       
+    }
+
     void commandSetRate(double stepDelay,double stepDistance)
     {
         PVStructurePtr pvArguments(
@@ -269,6 +391,19 @@ public:
         PVStructurePtr response(pvaClientChannel->rpc(pvRequest,pvArguments));
         cout << "response\n" << response << "\n";
     }
+
+    void commandSetPublishRate(double rate)
+    {
+        PVStructurePtr pvArguments(
+             getPVDataCreate()->createPVStructure(
+                 makeSetPublishRateArgumentStructure()));
+        pvArguments->getSubField<PVDouble>("value")->put(rate);
+        PVStructurePtr pvRequest = 
+             getPVDataCreate()->createPVStructure(makeRequestStructure());
+        pvRequest->getSubFieldT<PVString>("method")->put("setPublishRate");
+        PVStructurePtr response(pvaClientChannel->rpc(pvRequest,pvArguments));
+        cout << "response\n" << response << "\n";
+    }
 };
 
 static void help()
@@ -280,6 +415,10 @@ static void help()
     cout << "   stop\n";
     cout << "   setRate stepDelay stepDistance\n";
     cout << "   setDebug true|false\n";
+    cout << "   setPublishRate rate (Hz, 0 publishes every step)\n";
+    cout << "   run stepDelay stepDistance x0 y0 ... xn yn\n";
+    cout << "   waitComplete\n";
+    cout << "   status\n";
 }
 
 int main(int argc,char *argv[])
@@ -319,16 +458,34 @@ int main(int argc,char *argv[])
                  clientRPC->commandStart();
             } else if(command=="stop") {
                  clientRPC->commandStop();
+            } else if(command=="waitComplete") {
+                 clientRPC->commandWaitComplete();
+            } else if(command=="status") {
+                 clientRPC->commandStatus();
             } else if(command=="setRate") {
                  if(argc!=4) throw std::runtime_error("illegal number of arguments");
                  double stepDelay = stod(argv[2]);
                  double stepDistance = stod(argv[3]);
                  clientRPC->commandSetRate(stepDelay,stepDistance);
+            } else if(command=="run") {
+                 if(argc<6) throw std::runtime_error("illegal number of arguments");
+                 double stepDelay = stod(argv[2]);
+                 double stepDistance = stod(argv[3]);
+                 string input;
+                 for(int i= 4; i < argc; ++i)
+                 {
+                     if(i>4) input += " ";
+                     input += argv[i];
+                 }
+                 clientRPC->commandRun(stepDelay,stepDistance,input);
             } else if(command=="setDebug") {
                  if(argc!=3) throw std::runtime_error("illegal number of arguments");
                  string sval = argv[2];
                  bool value = (sval=="true" ? "true" : "false");
                  clientRPC->commandSetDebug(value);
+            } else if(command=="setPublishRate") {
+                 if(argc!=3) throw std::runtime_error("illegal number of arguments");
+                 clientRPC->commandSetPublishRate(stod(argv[2]));
             } else {
                 cout << "unknown command\n";
             }
@@ -14,6 +14,8 @@
 #include <pv/timeStamp.h>
 #include <pv/pvTimeStamp.h>
 #include <pv/scanService.h>
+#include <pv/publishLimiter.h>
+#include <pv/scanHistory.h>
 
 #include <shareLib.h>
 
@@ -51,13 +53,66 @@ public:
     virtual void update(int flags);
 
     ScanServicePtr getScanService() { return scanService; }
+    /**
+     * The scan service updates the record through this,
+     * so its maximum rate is the rate the record publishes at.
+     */
+    PublishLimiterPtr getPublishLimiter() { return publishLimiter; }
 
 private:
+    /**
+     * The index of each command in argument.command.choices.
+     */
+    enum Command {
+        CONFIGURE,
+        CONFIGURE_ENCODED,
+        CONFIGURE_TRAJECTORY,
+        START,
+        STOP,
+        SET_RATE,
+        SET_DEBUG,
+        SET_PUBLISH_RATE,
+        DUMP_TRACE,
+        STATUS,
+        BATCH,
+        COMMAND_COUNT
+    };
+    struct CommandEntry
+    {
+        const char * name;
+        const char * success;
+        ScanTrace::RequestCode trace;
+        void (ScanServerPutGet::*run)();
+        // null if the command can not be batched
+        void (ScanServerPutGet::*add)(ScanService::Batch & batch);
+    };
+    static const CommandEntry commandTable[COMMAND_COUNT];
 
     ScanServerPutGet(std::string const & recordName,
         epics::pvData::PVStructurePtr const & pvStructure);
     void initPvt();
 
+    ScanPlanPtr getConfigPlan();
+    ScanPlanPtr getEncodedPlan();
+    void runConfigure();
+    void runConfigureEncoded();
+    void runConfigureTrajectory();
+    void runStart();
+    void runStop();
+    void runSetRate();
+    void runSetDebug();
+    void runSetPublishRate();
+    void runDumpTrace();
+    void runStatus();
+    void runBatch();
+    void addConfigure(ScanService::Batch & batch);
+    void addConfigureEncoded(ScanService::Batch & batch);
+    void addConfigureTrajectory(ScanService::Batch & batch);
+    void addStart(ScanService::Batch & batch);
+    void addStop(ScanService::Batch & batch);
+    void addSetRate(ScanService::Batch & batch);
+    void addSetDebug(ScanService::Batch & batch);
+
     epics::pvData::PVDoublePtr      pvx;
     epics::pvData::PVDoublePtr      pvy;
     epics::pvData::PVDoublePtr      pvx_rb;
@@ -66,10 +121,37 @@ private:
     epics::pvData::PVTimeStamp pvTimeStamp;
     epics::pvData::PVTimeStamp pvTimeStamp_sp;
     epics::pvData::PVTimeStamp pvTimeStamp_rb;
+    ScanHistoryPtr scanHistory;
+
+    // the argument and result fields, so process looks nothing up by name
+    epics::pvData::PVIntPtr         pvCommand;
+    epics::pvData::PVIntArrayPtr    pvCommands;
+    epics::pvData::PVDoubleArrayPtr pvConfigX;
+    epics::pvData::PVDoubleArrayPtr pvConfigY;
+    epics::pvData::PVDoublePtr      pvScale;
+    epics::pvData::PVDoublePtr      pvXOffset;
+    epics::pvData::PVDoublePtr      pvYOffset;
+    epics::pvData::PVIntPtr         pvCount;
+    epics::pvData::PVUByteArrayPtr  pvEncodedX;
+    epics::pvData::PVUByteArrayPtr  pvEncodedY;
+    epics::pvData::PVStructurePtr   pvTrajectoryArg;
+    epics::pvData::PVDoublePtr      pvStepDelay;
+    epics::pvData::PVDoublePtr      pvStepDistance;
+    epics::pvData::PVBooleanPtr     pvDebug;
+    epics::pvData::PVDoublePtr      pvPublishRate;
+    epics::pvData::PVStringPtr      pvTraceFileName;
+    epics::pvData::PVStringPtr      pvResult;
+    epics::pvData::PVStringArrayPtr pvResults;
+    epics::pvData::PVStructurePtr   pvStatus;
+    std::string successResults[COMMAND_COUNT];
+    // per command entries of result.results; the last is for an illegal index
+    std::string batchSuccess[COMMAND_COUNT + 1];
+    std::string batchNotRun[COMMAND_COUNT + 1];
 
     bool firstTime;
 
     ScanServicePtr scanService;
+    PublishLimiterPtr publishLimiter;
 };
 
 
@@ -14,8 +14,13 @@
 #include <pv/standardField.h>
 #include <pv/standardPVField.h>
 
+#include <sstream>
+
 #include <epicsThread.h>
 #include <pv/scanService.h>
+#include <pv/trajectory.h>
+#include <pv/scanStatus.h>
+#include <pv/pointDecoder.h>
 #include <epicsExport.h>
 #include "pv/scanServerPutGet.h"
 
@@ -72,12 +77,36 @@ static StructureConstPtr makeRecordStructure()
             add("positionSP", makePointTopStructure())->
             add("positionRB", makePointTopStructure())->
             add("timeStamp", getStandardField()->timeStamp())->
+            add("history", ScanHistory::getStructure())->
             addNestedStructure("argument")->
-               add("command",pvString)->
+               add("command",getStandardField()->enumerated())->
+               addArray("commands",pvInt)->
                addNestedStructure("configArg")->
                   addArray("x",pvDouble) ->
                   addArray("y",pvDouble) ->
                   endNested()->
+               add("encodedArg",PointDecoder::getEncodedStructure()) ->
+               addNestedStructure("trajectoryArg")->
+                  add("type",pvString) ->
+                  add("xStart",pvDouble) ->
+                  add("xStop",pvDouble) ->
+                  add("xStep",pvDouble) ->
+                  add("nx",pvInt) ->
+                  add("yStart",pvDouble) ->
+                  add("yStop",pvDouble) ->
+                  add("yStep",pvDouble) ->
+                  add("ny",pvInt) ->
+                  add("xCenter",pvDouble) ->
+                  add("yCenter",pvDouble) ->
+                  add("xAmplitude",pvDouble) ->
+                  add("yAmplitude",pvDouble) ->
+                  add("xFrequency",pvDouble) ->
+                  add("yFrequency",pvDouble) ->
+                  add("phase",pvDouble) ->
+                  add("pitch",pvDouble) ->
+                  add("pointsPerTurn",pvInt) ->
+                  add("npoints",pvInt) ->
+                  endNested()->
                addNestedStructure("rateArg")->
                   add("stepDelay",pvDouble) ->
                   add("stepDistance",pvDouble) ->
@@ -85,9 +114,17 @@ static StructureConstPtr makeRecordStructure()
                addNestedStructure("debugArg")->
                   add("value",pvBoolean) ->
                   endNested()->
+               addNestedStructure("publishArg")->
+                  add("rate",pvDouble) ->
+                  endNested()->
+               addNestedStructure("traceArg")->
+                  add("fileName",pvString) ->
+                  endNested()->
                endNested()->
             addNestedStructure("result")->
                add("value",pvString) ->
+               addArray("results",pvString) ->
+               add("status",ScanStatus::getStructure()) ->
                endNested()->
             createStructure();
     }
@@ -107,28 +144,34 @@ void ScanServerPutGet::Callback::update(int flags)
 
 void ScanServerPutGet::update(int flags)
 {
+    epicsUInt64 start = epicsMonotonicGet();
     lock();
+    scanService->getMetrics()->getLockWait().record(epicsMonotonicGet() - start);
     try {
+        ScanSnapshot snapshot = scanService->getSnapshot();
         TimeStamp timeStamp;
         timeStamp.getCurrent();
         beginGroupPut();
 
         if ((flags & ScanService::Callback::SETPOINT_CHANGED) != 0)
         {
-            Point sp = scanService->getPositionSetpoint();
-            pvx->put(sp.x);
-            pvy->put(sp.y);
+            pvx->put(snapshot.setpoint.x);
+            pvy->put(snapshot.setpoint.y);
             pvTimeStamp_sp.set(timeStamp);
         }
 
         if ((flags & ScanService::Callback::READBACK_CHANGED) != 0)
         {
-            Point rb = scanService->getPositionReadback();
-            pvx_rb->put(rb.x);
-            pvy_rb->put(rb.y);
+            pvx_rb->put(snapshot.readback.x);
+            pvy_rb->put(snapshot.readback.y);
             pvTimeStamp_rb.set(timeStamp);
         }
 
+        if ((flags & ScanService::Callback::HISTORY_CHANGED) != 0)
+        {
+            scanHistory->put();
+        }
+
         pvTimeStamp.set(timeStamp);
         endGroupPut();
     }
@@ -170,6 +213,40 @@ ScanServerPutGet::ScanServerPutGet(
     pvTimeStamp_rb.attach(pvStructure->getSubFieldT<PVStructure>("positionRB.timeStamp"));
 
     scanService = ScanService::create();
+    scanHistory = ScanHistory::create(
+        pvStructure->getSubFieldT<PVStructure>("history"),scanService->getHistory());
+
+    pvCommand       = pvStructure->getSubFieldT<PVInt>("argument.command.index");
+    pvCommands      = pvStructure->getSubFieldT<PVIntArray>("argument.commands");
+    pvConfigX       = pvStructure->getSubFieldT<PVDoubleArray>("argument.configArg.x");
+    pvConfigY       = pvStructure->getSubFieldT<PVDoubleArray>("argument.configArg.y");
+    pvScale         = pvStructure->getSubFieldT<PVDouble>("argument.encodedArg.scale");
+    pvXOffset       = pvStructure->getSubFieldT<PVDouble>("argument.encodedArg.xOffset");
+    pvYOffset       = pvStructure->getSubFieldT<PVDouble>("argument.encodedArg.yOffset");
+    pvCount         = pvStructure->getSubFieldT<PVInt>("argument.encodedArg.count");
+    pvEncodedX      = pvStructure->getSubFieldT<PVUByteArray>("argument.encodedArg.x");
+    pvEncodedY      = pvStructure->getSubFieldT<PVUByteArray>("argument.encodedArg.y");
+    pvTrajectoryArg = pvStructure->getSubFieldT<PVStructure>("argument.trajectoryArg");
+    pvStepDelay     = pvStructure->getSubFieldT<PVDouble>("argument.rateArg.stepDelay");
+    pvStepDistance  = pvStructure->getSubFieldT<PVDouble>("argument.rateArg.stepDistance");
+    pvDebug         = pvStructure->getSubFieldT<PVBoolean>("argument.debugArg.value");
+    pvPublishRate   = pvStructure->getSubFieldT<PVDouble>("argument.publishArg.rate");
+    pvTraceFileName = pvStructure->getSubFieldT<PVString>("argument.traceArg.fileName");
+    pvResult        = pvStructure->getSubFieldT<PVString>("result.value");
+    pvResults       = pvStructure->getSubFieldT<PVStringArray>("result.results");
+    pvStatus        = pvStructure->getSubFieldT<PVStructure>("result.status");
+
+    shared_vector<string> choices(COMMAND_COUNT);
+    for (size_t i=0; i<COMMAND_COUNT; ++i)
+    {
+        choices[i] = commandTable[i].name;
+        successResults[i] = commandTable[i].success;
+        batchSuccess[i] = string(commandTable[i].name) + " success";
+        batchNotRun[i] = string(commandTable[i].name) + " not run";
+    }
+    batchSuccess[COMMAND_COUNT] = "illegal success";
+    batchNotRun[COMMAND_COUNT] = "illegal not run";
+    pvStructure->getSubFieldT<PVStringArray>("argument.command.choices")->replace(freeze(choices));
 }
 
 void ScanServerPutGet::initPvt()
@@ -177,84 +254,213 @@ void ScanServerPutGet::initPvt()
     initPVRecord();
 
     PVFieldPtr pvField;
-    scanService->registerCallback(
-        Callback::create(std::tr1::dynamic_pointer_cast<ScanServerPutGet>(shared_from_this())));
+    publishLimiter = PublishLimiter::create(
+        Callback::create(std::tr1::dynamic_pointer_cast<ScanServerPutGet>(shared_from_this())),
+        scanService->getExecutor());
+    scanService->registerCallback(publishLimiter);
 }
 
 
-void ScanServerPutGet::process()
+// indexed by Command; a batched command takes its arguments from the same fields
+const ScanServerPutGet::CommandEntry ScanServerPutGet::commandTable[COMMAND_COUNT] = {
+    {"configure","configure success",ScanTrace::REQUEST_CONFIGURE,
+        &ScanServerPutGet::runConfigure,&ScanServerPutGet::addConfigure},
+    {"configureEncoded","configureEncoded success",ScanTrace::REQUEST_CONFIGURE,
+        &ScanServerPutGet::runConfigureEncoded,&ScanServerPutGet::addConfigureEncoded},
+    {"configureTrajectory","configureTrajectory success",ScanTrace::REQUEST_CONFIGURE_TRAJECTORY,
+        &ScanServerPutGet::runConfigureTrajectory,&ScanServerPutGet::addConfigureTrajectory},
+    {"start","startScan success",ScanTrace::REQUEST_START,
+        &ScanServerPutGet::runStart,&ScanServerPutGet::addStart},
+    {"stop","stopScan success",ScanTrace::REQUEST_STOP,
+        &ScanServerPutGet::runStop,&ScanServerPutGet::addStop},
+    {"setRate","setRate success",ScanTrace::REQUEST_SET_RATE,
+        &ScanServerPutGet::runSetRate,&ScanServerPutGet::addSetRate},
+    {"setDebug","setDebug success",ScanTrace::REQUEST_SET_DEBUG,
+        &ScanServerPutGet::runSetDebug,&ScanServerPutGet::addSetDebug},
+    {"setPublishRate","setPublishRate success",ScanTrace::REQUEST_SET_PUBLISH_RATE,
+        &ScanServerPutGet::runSetPublishRate,0},
+    {"dumpTrace","dumpTrace success",ScanTrace::REQUEST_DUMP_TRACE,
+        &ScanServerPutGet::runDumpTrace,0},
+    {"status","status success",ScanTrace::REQUEST_STATUS,
+        &ScanServerPutGet::runStatus,0},
+    {"batch","batch success",ScanTrace::REQUEST_BATCH,
+        &ScanServerPutGet::runBatch,0}
+};
+
+ScanPlanPtr ScanServerPutGet::getConfigPlan()
 {
-    PVStructurePtr pvStructure(getPVStructure());
-    PVStringPtr pvResult(pvStructure->getSubField<PVString>("result.value"));
-    string command(pvStructure->getSubField<PVString>("argument.command")->get());
-    if(command=="configure") {
-        PVDoubleArrayPtr pvx(pvStructure->getSubField<PVDoubleArray>("argument.configArg.x"));
-        PVDoubleArrayPtr pvy(pvStructure->getSubField<PVDoubleArray>("argument.configArg.y"));
-        size_t npoints = pvx->getLength();
-        if(npoints!=pvy->getLength()) {
-           throw std::logic_error(
-               "argument.configArg.x and argument.configArg.y not same length");
-        }
-        std::vector<Point> newPoints;
-        PVDoubleArray::const_svector xvalue(pvx->view());
-        PVDoubleArray::const_svector yvalue(pvy->view());
-        for(size_t i=0; i<npoints; ++i) {
-             double x = xvalue[i];
-             double y = yvalue[i];
-             newPoints.push_back(Point(x,y));
+    // the plan shares the argument arrays; a later put replaces them
+    return PointListPlan::create(pvConfigX->view(),pvConfigY->view());
+}
+
+ScanPlanPtr ScanServerPutGet::getEncodedPlan()
+{
+    return PointDecoder::decodeEncoded(
+        pvScale->get(),pvXOffset->get(),pvYOffset->get(),pvCount->get(),
+        pvEncodedX->view(),pvEncodedY->view());
+}
+
+void ScanServerPutGet::runConfigure()
+{
+    scanService->configure(getConfigPlan());
+    pvResult->put(successResults[CONFIGURE]);
+}
+
+void ScanServerPutGet::runConfigureEncoded()
+{
+    scanService->configure(getEncodedPlan());
+    pvResult->put(successResults[CONFIGURE_ENCODED]);
+}
+
+void ScanServerPutGet::runConfigureTrajectory()
+{
+    scanService->configure(createTrajectory(pvTrajectoryArg));
+    pvResult->put(successResults[CONFIGURE_TRAJECTORY]);
+}
+
+void ScanServerPutGet::runStart()
+{
+    scanService->startScan();
+    pvResult->put(successResults[START]);
+}
+
+void ScanServerPutGet::runStop()
+{
+    scanService->stopScan();
+    pvResult->put(successResults[STOP]);
+}
+
+void ScanServerPutGet::runSetRate()
+{
+    scanService->setRate(pvStepDelay->get(),pvStepDistance->get());
+    pvResult->put(successResults[SET_RATE]);
+}
+
+void ScanServerPutGet::runSetDebug()
+{
+    scanService->setDebug(pvDebug->get());
+    pvResult->put(successResults[SET_DEBUG]);
+}
+
+void ScanServerPutGet::runSetPublishRate()
+{
+    publishLimiter->setMaxRate(pvPublishRate->get());
+    pvResult->put(successResults[SET_PUBLISH_RATE]);
+}
+
+void ScanServerPutGet::runDumpTrace()
+{
+    size_t count = ScanTrace::getShared()->dumpNamed(pvTraceFileName->get());
+    std::stringstream ss;
+    ss << "dumpTrace wrote " << count << " events";
+    pvResult->put(ss.str());
+}
+
+void ScanServerPutGet::runStatus()
+{
+    ScanStatus::put(pvStatus,scanService->getSnapshot());
+    pvResult->put(successResults[STATUS]);
+}
+
+void ScanServerPutGet::addConfigure(ScanService::Batch & batch)
+{
+    batch.configure(getConfigPlan());
+}
+
+void ScanServerPutGet::addConfigureEncoded(ScanService::Batch & batch)
+{
+    batch.configure(getEncodedPlan());
+}
+
+void ScanServerPutGet::addConfigureTrajectory(ScanService::Batch & batch)
+{
+    batch.configure(createTrajectory(pvTrajectoryArg));
+}
+
+void ScanServerPutGet::addStart(ScanService::Batch & batch)
+{
+    batch.startScan();
+}
+
+void ScanServerPutGet::addStop(ScanService::Batch & batch)
+{
+    batch.stopScan();
+}
+
+void ScanServerPutGet::addSetRate(ScanService::Batch & batch)
+{
+    batch.setRate(pvStepDelay->get(),pvStepDistance->get());
+}
+
+void ScanServerPutGet::addSetDebug(ScanService::Batch & batch)
+{
+    batch.setDebug(pvDebug->get());
+}
+
+// argument.commands holds indexes into argument.command.choices
+void ScanServerPutGet::runBatch()
+{
+    PVIntArray::const_svector commands(pvCommands->view());
+    shared_vector<string> results(commands.size());
+    ScanService::Batch batch;
+    size_t decoded = 0;
+    string error;
+    try {
+        for(; decoded<commands.size(); ++decoded) {
+            int32 index = commands[decoded];
+            if(index<0 || index>=COMMAND_COUNT) {
+                throw std::runtime_error("illegal command index");
+            }
+            if(!commandTable[index].add) {
+                throw std::runtime_error(string("command ") + commandTable[index].name + " can not be batched");
+            }
+            (this->*commandTable[index].add)(batch);
         }
+    } catch (std::exception& e) {
+        error = e.what();
+    }
+    // a command that can not be decoded stops the batch before anything runs
+    size_t done = 0;
+    size_t failed = decoded;
+    if(decoded==commands.size()) {
+        done = scanService->execute(batch,error);
+        failed = done;
+    }
+    for(size_t i=0; i<commands.size(); ++i)
+    {
+        int32 index = commands[i];
+        if(index<0 || index>=COMMAND_COUNT) index = COMMAND_COUNT;
+        if(i<done) results[i] = batchSuccess[index];
+        else if(i==failed) results[i] = string(index<COMMAND_COUNT ? commandTable[index].name : "illegal")
+            + " exception " + error;
+        else results[i] = batchNotRun[index];
+    }
+    pvResults->replace(freeze(results));
+    if(failed==commands.size()) {
+        pvResult->put(successResults[BATCH]);
+    } else {
+        std::stringstream ss;
+        ss << "batch stopped at command " << failed;
+        pvResult->put(ss.str());
+    }
+}
+
+void ScanServerPutGet::process()
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    int32 index = pvCommand->get();
+    if(index<0 || index>=COMMAND_COUNT) {
+        pvResult->put("illegal command index");
+    } else {
+        const CommandEntry & entry = commandTable[index];
+        scanService->trace(ScanTrace::REQUEST,entry.trace);
         try {
-            getScanService()->configure(newPoints);
-            pvResult->put("configure success");
-        } catch (std::exception& e) {
-            string result("exception ");
-            result += e.what();
-            pvResult->put(result);
-       }
-    } else if(command=="start") {
-       try {
-            getScanService()->startScan();
-            pvResult->put("startScan success");
-       } catch (std::exception& e) {
-           string result("exception ");
-           result += e.what();
-           pvResult->put(result);
-       }
-    } else if(command=="stop") {
-       try {
-            getScanService()->stopScan();
-            pvResult->put("stopScan success");
-       } catch (std::exception& e) {
-           string result("exception ");
-           result += e.what();
-           pvResult->put(result);
-       }
-     } else if(command=="setRate") {
-        PVDoublePtr pvStepDelay(pvStructure->getSubField<PVDouble>("argument.rateArg.stepDelay"));
-        PVDoublePtr pvStepDistance(pvStructure->getSubField<PVDouble>("argument.rateArg.stepDistance"));
-        double stepDelay = pvStepDelay->get();
-        double stepDistance = pvStepDistance->get();
-        try {
-            getScanService()->setRate(stepDelay,stepDistance);;
-            pvResult->put("configure success");
-        } catch (std::exception& e) {
-            string result("exception ");
-            result += e.what();
-            pvResult->put(result);
-       }
-     } else if(command=="setDebug") {
-        PVBooleanPtr pvDebug(pvStructure->getSubField<PVBoolean>("argument.debugArg.value"));
-        bool debug = pvDebug->get();
-        try {
-            getScanService()->setDebug(debug);;
-            pvResult->put("configure success");
+            (this->*entry.run)();
         } catch (std::exception& e) {
             string result("exception ");
             result += e.what();
             pvResult->put(result);
-       }
-    } else {
-       pvResult->put("illegal command index");
+        }
     }
     PVRecord::process();
 }
@@ -13,6 +13,7 @@
 #include <iostream>
 
 #include <pv/scanServerPutGet.h>
+#include <pv/scanStatsRecord.h>
 #include <pv/channelProviderLocal.h>
 
 using namespace std;
@@ -29,7 +30,9 @@ int main(int argc,char *argv[])
     string recordName;
 
     recordName = "scanServerPutGet";
-    pvRecord = ScanServerPutGet::create(recordName);
+    ScanServerPutGetPtr record = ScanServerPutGet::create(recordName);
+    master->addRecord(record);
+    pvRecord = ScanStatsRecord::create(recordName + ":stats",record->getScanService());
     master->addRecord(pvRecord);
 
     ServerContext::shared_pointer ctx =
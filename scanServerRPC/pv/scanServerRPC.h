@@ -14,6 +14,9 @@
 #include <pv/timeStamp.h>
 #include <pv/pvTimeStamp.h>
 #include <pv/scanService.h>
+#include <pv/pointDecoder.h>
+#include <pv/publishLimiter.h>
+#include <pv/scanHistory.h>
 
 #include <shareLib.h>
 
@@ -21,9 +24,15 @@
 namespace epics { namespace exampleScan { 
 
 
+class ResultFactory;
+typedef std::tr1::shared_ptr<ResultFactory> ResultFactoryPtr;
+
 class ConfigureService;
 typedef std::tr1::shared_ptr<ConfigureService> ConfigureServicePtr;
 
+class ConfigureTrajectoryService;
+typedef std::tr1::shared_ptr<ConfigureTrajectoryService> ConfigureTrajectoryServicePtr;
+
 class StartService;
 typedef std::tr1::shared_ptr<StartService> StartServicePtr;
 
@@ -36,6 +45,18 @@ typedef std::tr1::shared_ptr<SetRateService> SetRateServicePtr;
 class SetDebugService;
 typedef std::tr1::shared_ptr<SetDebugService> SetDebugServicePtr;
 
+class SetPublishRateService;
+typedef std::tr1::shared_ptr<SetPublishRateService> SetPublishRateServicePtr;
+
+
+class DumpTraceService;
+typedef std::tr1::shared_ptr<DumpTraceService> DumpTraceServicePtr;
+
+class StatusService;
+typedef std::tr1::shared_ptr<StatusService> StatusServicePtr;
+
+class BatchService;
+typedef std::tr1::shared_ptr<BatchService> BatchServicePtr;
 
 class ScanRPCService;
 typedef std::tr1::shared_ptr<ScanRPCService> ScanRPCServicePtr;
@@ -43,15 +64,50 @@ typedef std::tr1::shared_ptr<ScanRPCService> ScanRPCServicePtr;
 class ScanServerRPC;
 typedef std::tr1::shared_ptr<ScanServerRPC> ScanServerRPCPtr;
 
+/**
+ * The results of the RPC methods.
+ * A result has a string value and an int status, statusOK on success.
+ * A fixed result is created once and shared by every reply;
+ * it is never written after it is created.
+ * A result with variable content is created for each reply,
+ * since pvAccess may still be sending the previous one.
+ * The introspection interfaces are created once, by the first create.
+ */
+class epicsShareClass ResultFactory
+{
+public:
+    POINTER_DEFINITIONS(ResultFactory);
+    const static int statusOK = 0;
+    const static int statusFailed = 1;
+    static ResultFactoryPtr create();
+    static epics::pvData::PVStructurePtr createFixed(const std::string & value);
+    epics::pvData::PVStructurePtr get(int status,const std::string & value);
+    /**
+     * A result that also has a string array results.
+     */
+    epics::pvData::PVStructurePtr getBatch(
+        int status,
+        const std::string & value,
+        epics::pvData::shared_vector<const std::string> const & results);
+    /**
+     * A ScanStatus structure holding snapshot.
+     */
+    epics::pvData::PVStructurePtr getStatus(ScanSnapshot const & snapshot);
+private:
+    ResultFactory() {}
+};
+
 class epicsShareClass ConfigureService :
     public virtual epics::pvAccess::RPCServiceAsync
 {
 public:
     POINTER_DEFINITIONS(ConfigureService);
 
-    static ConfigureService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
+    static ConfigureService::shared_pointer create(
+        ScanServicePtr const & scanService,
+        PointDecoderPtr const & pointDecoder)
     {
-        return ConfigureServicePtr(new ConfigureService(pvRecord));
+        return ConfigureServicePtr(new ConfigureService(scanService,pointDecoder));
     }
     ~ConfigureService() {};
 
@@ -60,12 +116,45 @@ public:
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     );
 private:
-    ConfigureService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    ConfigureService(ScanServicePtr const & scanService,
+        PointDecoderPtr const & pointDecoder)
+    : scanService(scanService),
+      pointDecoder(pointDecoder),
+      success(ResultFactory::createFixed("configure success"))
+    {
+    }
+
+    ScanServicePtr scanService;
+    PointDecoderPtr pointDecoder;
+    epics::pvData::PVStructurePtr success;
+};
+
+
+class epicsShareClass ConfigureTrajectoryService :
+    public virtual epics::pvAccess::RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(ConfigureTrajectoryService);
+
+    static ConfigureTrajectoryService::shared_pointer create(ScanServicePtr const & scanService)
+    {
+        return ConfigureTrajectoryServicePtr(new ConfigureTrajectoryService(scanService));
+    }
+    ~ConfigureTrajectoryService() {};
+
+    void request(
+        epics::pvData::PVStructurePtr const & args,
+        epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+    );
+private:
+    ConfigureTrajectoryService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      success(ResultFactory::createFixed("configureTrajectory success"))
     {
     }
 
-    ScanServerRPCPtr pvRecord;
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr success;
 };
 
 
@@ -75,9 +164,9 @@ class epicsShareClass StartService :
 public:
     POINTER_DEFINITIONS(StartService);
 
-    static StartService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
+    static StartService::shared_pointer create(ScanServicePtr const & scanService)
     {
-        return StartServicePtr(new StartService(pvRecord));
+        return StartServicePtr(new StartService(scanService));
     }
     ~StartService() {};
 
@@ -86,12 +175,14 @@ public:
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     ); 
 private:
-    StartService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    StartService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      success(ResultFactory::createFixed("start success"))
     {
     }
 
-    ScanServerRPCPtr pvRecord;
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr success;
 };
 
 class epicsShareClass StopService :
@@ -100,9 +191,9 @@ class epicsShareClass StopService :
 public:
     POINTER_DEFINITIONS(StopService);
 
-    static StopService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
+    static StopService::shared_pointer create(ScanServicePtr const & scanService)
     {
-        return StopServicePtr(new StopService(pvRecord));
+        return StopServicePtr(new StopService(scanService));
     }
     ~StopService() {};
 
@@ -111,12 +202,14 @@ public:
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     ); 
 private:
-    StopService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    StopService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      success(ResultFactory::createFixed("stop success"))
     {
     }
 
-    ScanServerRPCPtr pvRecord;
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr success;
 };
 
 class epicsShareClass SetRateService :
@@ -125,9 +218,9 @@ class epicsShareClass SetRateService :
 public:
     POINTER_DEFINITIONS(SetRateService);
 
-    static SetRateService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
+    static SetRateService::shared_pointer create(ScanServicePtr const & scanService)
     {
-        return SetRateServicePtr(new SetRateService(pvRecord));
+        return SetRateServicePtr(new SetRateService(scanService));
     }
     ~SetRateService() {};
 
@@ -136,12 +229,14 @@ public:
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     ); 
 private:
-    SetRateService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    SetRateService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      success(ResultFactory::createFixed("setRate success"))
     {
     }
 
-    ScanServerRPCPtr pvRecord;
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr success;
 };
 
 class epicsShareClass SetDebugService :
@@ -150,9 +245,9 @@ class epicsShareClass SetDebugService :
 public:
     POINTER_DEFINITIONS(SetDebugService);
 
-    static SetDebugService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
+    static SetDebugService::shared_pointer create(ScanServicePtr const & scanService)
     {
-        return SetDebugServicePtr(new SetDebugService(pvRecord));
+        return SetDebugServicePtr(new SetDebugService(scanService));
     }
     ~SetDebugService() {};
 
@@ -161,63 +256,207 @@ public:
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     ); 
 private:
-    SetDebugService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    SetDebugService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      success(ResultFactory::createFixed("setDebug success"))
+    {
+    }
+
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr success;
+};
+
+class epicsShareClass SetPublishRateService :
+    public virtual epics::pvAccess::RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(SetPublishRateService);
+
+    static SetPublishRateService::shared_pointer create(
+        ScanServicePtr const & scanService,
+        PublishLimiterPtr const & publishLimiter)
+    {
+        return SetPublishRateServicePtr(new SetPublishRateService(scanService,publishLimiter));
+    }
+    ~SetPublishRateService() {};
+
+    void request(
+        epics::pvData::PVStructurePtr const & args,
+        epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+    ); 
+private:
+    SetPublishRateService(ScanServicePtr const & scanService,
+        PublishLimiterPtr const & publishLimiter)
+    : scanService(scanService),
+      publishLimiter(publishLimiter),
+      success(ResultFactory::createFixed("setPublishRate success"))
     {
     }
 
-    ScanServerRPCPtr pvRecord;
+    ScanServicePtr scanService;
+    PublishLimiterPtr publishLimiter;
+    epics::pvData::PVStructurePtr success;
 };
 
+class epicsShareClass DumpTraceService :
+    public virtual epics::pvAccess::RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(DumpTraceService);
+
+    static DumpTraceService::shared_pointer create(
+        ScanServicePtr const & scanService,
+        ResultFactoryPtr const & resultFactory)
+    {
+        return DumpTraceServicePtr(new DumpTraceService(scanService,resultFactory));
+    }
+    ~DumpTraceService() {};
+
+    void request(
+        epics::pvData::PVStructurePtr const & args,
+        epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+    ); 
+private:
+    DumpTraceService(ScanServicePtr const & scanService,
+        ResultFactoryPtr const & resultFactory)
+    : scanService(scanService),
+      resultFactory(resultFactory)
+    {
+    }
+
+    ScanServicePtr scanService;
+    ResultFactoryPtr resultFactory;
+};
+
+/**
+ * Method status: the ScanStatus of the latest snapshot.
+ * It never waits for the scan service mutex.
+ */
+class epicsShareClass StatusService :
+    public virtual epics::pvAccess::RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(StatusService);
+
+    static StatusService::shared_pointer create(
+        ScanServicePtr const & scanService,
+        ResultFactoryPtr const & resultFactory)
+    {
+        return StatusServicePtr(new StatusService(scanService,resultFactory));
+    }
+    ~StatusService() {};
+
+    void request(
+        epics::pvData::PVStructurePtr const & args,
+        epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+    ); 
+private:
+    StatusService(ScanServicePtr const & scanService,
+        ResultFactoryPtr const & resultFactory)
+    : scanService(scanService),
+      resultFactory(resultFactory)
+    {
+    }
+
+    ScanServicePtr scanService;
+    ResultFactoryPtr resultFactory;
+};
+
+/**
+ * Method batch: argument commands is a union array whose elements are
+ * structures with a string field method and the arguments of that method.
+ * All commands are decoded before any runs, then they run in order under
+ * one service lock and stop at the first failure.
+ * The result has a string per command.
+ */
+class epicsShareClass BatchService :
+    public virtual epics::pvAccess::RPCServiceAsync
+{
+public:
+    POINTER_DEFINITIONS(BatchService);
+
+    static BatchService::shared_pointer create(
+        ScanServicePtr const & scanService,
+        PointDecoderPtr const & pointDecoder,
+        ResultFactoryPtr const & resultFactory)
+    {
+        return BatchServicePtr(new BatchService(scanService,pointDecoder,resultFactory));
+    }
+    ~BatchService() {};
+
+    void request(
+        epics::pvData::PVStructurePtr const & args,
+        epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+    ); 
+private:
+    BatchService(ScanServicePtr const & scanService,
+        PointDecoderPtr const & pointDecoder,
+        ResultFactoryPtr const & resultFactory)
+    : scanService(scanService),
+      pointDecoder(pointDecoder),
+      resultFactory(resultFactory)
+    {
+    }
+
+    ScanServicePtr scanService;
+    PointDecoderPtr pointDecoder;
+    ResultFactoryPtr resultFactory;
+};
+
+/**
+ * Method waitComplete: replies when the current scan completes,
+ * or the next one if no scan is active.
+ * Up to maxWaiters clients can wait; past that a request fails.
+ * They are kept in a list and all are answered by the one callback
+ * this service registers with the scan service.
+ */
 class epicsShareClass ScanRPCService :
-    public epics::pvAccess::RPCServiceAsync,
-    public std::tr1::enable_shared_from_this<ScanRPCService>
+    public epics::pvAccess::RPCServiceAsync
 {
 public:
     POINTER_DEFINITIONS(ScanRPCService);
-
-    virtual void update(int flags);
+    const static size_t maxWaiters = 1024;
 
     class Callback : public ScanService::Callback
     {
     public:
         POINTER_DEFINITIONS(Callback);
-        static Callback::shared_pointer create(ScanRPCServicePtr const & record);
+        static Callback::shared_pointer create(ScanRPCServicePtr const & service);
 
         virtual void update(int flags);
 
     private:
-        Callback(ScanRPCServicePtr service)
+        Callback(ScanRPCServicePtr const & service)
         : service(service)
         {}
 
-        ScanRPCServicePtr service;
+        // weak, the scan service holds the callback
+        std::tr1::weak_ptr<ScanRPCService> service;
     };
 
-    static ScanRPCService::shared_pointer create(ScanServerRPCPtr const & pvRecord)
-    {
-        return ScanRPCServicePtr(new ScanRPCService(pvRecord));
-    }
-    
+    static ScanRPCService::shared_pointer create(ScanServicePtr const & scanService);
+    ~ScanRPCService();
+
     void request(
         epics::pvData::PVStructurePtr const & args,
         epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
     );
+    void update(int flags);
+    size_t getWaiterCount();
 private:
-    ScanRPCService(ScanServerRPCPtr const & pvRecord)
-    : pvRecord(pvRecord)
+    ScanRPCService(ScanServicePtr const & scanService)
+    : scanService(scanService),
+      complete(ResultFactory::createFixed("scan complete"))
     {
     }
 
-    virtual void scanComplete();
-
-    void handleError(const std::string & message);
-
-    epics::pvAccess::RPCResponseCallback::shared_pointer rpcCallback;
+    void scanComplete();
 
+    ScanServicePtr scanService;
+    epics::pvData::PVStructurePtr complete;
     Callback::shared_pointer scanServiceCallback;
-
-    ScanServerRPCPtr pvRecord;
+    std::vector<epics::pvAccess::RPCResponseCallback::shared_pointer> waiters;
+    epics::pvData::Mutex mutex;
 };
 
 
@@ -253,8 +492,31 @@ public:
     virtual void update(int flags);
 
     ScanServicePtr getScanService() { return scanService; }
+    PointDecoderPtr getPointDecoder() { return pointDecoder; }
+    /**
+     * The scan service updates the record through this,
+     * so its maximum rate is the rate the record publishes at.
+     */
+    PublishLimiterPtr getPublishLimiter() { return publishLimiter; }
+
+    /**
+     * Make a method available through getService.
+     * The one service object serves every request for the method,
+     * so its request must be safe to call concurrently.
+     * A service already registered for the method is replaced.
+     */
+    void registerService(
+        std::string const & method,
+        epics::pvAccess::RPCServiceAsync::shared_pointer const & service);
 
 private:
+    struct MethodEntry
+    {
+        size_t hash;
+        std::string method;
+        epics::pvAccess::RPCServiceAsync::shared_pointer service;
+    };
+    const static size_t methodTableSize = 16;
 
     ScanServerRPC(std::string const & recordName,
         epics::pvData::PVStructurePtr const & pvStructure);
@@ -268,10 +530,18 @@ private:
     epics::pvData::PVTimeStamp pvTimeStamp;
     epics::pvData::PVTimeStamp pvTimeStamp_sp;
     epics::pvData::PVTimeStamp pvTimeStamp_rb;
+    ScanHistoryPtr scanHistory;
 
     bool firstTime;
 
     ScanServicePtr scanService;
+    PointDecoderPtr pointDecoder;
+    ResultFactoryPtr resultFactory;
+    PublishLimiterPtr publishLimiter;
+
+    // method services hashed by name
+    std::vector<MethodEntry> methodTable[methodTableSize];
+    epics::pvData::Mutex methodMutex;
 };
 
 
@@ -13,8 +13,12 @@
 #include <pv/standardField.h>
 #include <pv/standardPVField.h>
 
+#include <sstream>
+
 #include <epicsThread.h>
 #include <pv/scanService.h>
+#include <pv/trajectory.h>
+#include <pv/scanStatus.h>
 #include <epicsExport.h>
 #include "pv/scanServerRPC.h"
 
@@ -26,19 +30,63 @@ using std::string;
 namespace epics { namespace exampleScan {
 
 
-static PVStructurePtr makeResultStructure(const std::string & result)
+static StructureConstPtr resultStructure;
+static StructureConstPtr batchResultStructure;
+static epicsThreadOnceId resultOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createResultStructures(void *)
 {
-    static StructureConstPtr resultStructure;
-    if (resultStructure.get() == 0)
-    {
-        FieldCreatePtr fieldCreate = getFieldCreate();
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    resultStructure = fieldCreate->createFieldBuilder()->
+        add("value",pvString) ->
+        add("status",pvInt) ->
+        createStructure();
+    batchResultStructure = fieldCreate->createFieldBuilder()->
+        add("value",pvString) ->
+        add("status",pvInt) ->
+        addArray("results",pvString) ->
+        createStructure();
+}
 
-        resultStructure = fieldCreate->createFieldBuilder()->
-            add("value",pvString) ->
-            createStructure();
-    }
+ResultFactoryPtr ResultFactory::create()
+{
+    epicsThreadOnce(&resultOnce,createResultStructures,0);
+    return ResultFactoryPtr(new ResultFactory());
+}
+
+PVStructurePtr ResultFactory::createFixed(const std::string & value)
+{
+    epicsThreadOnce(&resultOnce,createResultStructures,0);
     PVStructurePtr pvResult = getPVDataCreate()->createPVStructure(resultStructure);
-    pvResult->getSubField<PVString>("value")->put(result);
+    pvResult->getSubField<PVString>("value")->put(value);
+    pvResult->getSubField<PVInt>("status")->put(statusOK);
+    return pvResult;
+}
+
+PVStructurePtr ResultFactory::get(int status,const std::string & value)
+{
+    PVStructurePtr pvResult = getPVDataCreate()->createPVStructure(resultStructure);
+    pvResult->getSubField<PVString>("value")->put(value);
+    pvResult->getSubField<PVInt>("status")->put(status);
+    return pvResult;
+}
+
+PVStructurePtr ResultFactory::getBatch(
+    int status,
+    const std::string & value,
+    shared_vector<const string> const & results)
+{
+    PVStructurePtr pvResult = getPVDataCreate()->createPVStructure(batchResultStructure);
+    pvResult->getSubField<PVString>("value")->put(value);
+    pvResult->getSubField<PVInt>("status")->put(status);
+    pvResult->getSubField<PVStringArray>("results")->replace(results);
+    return pvResult;
+}
+
+PVStructurePtr ResultFactory::getStatus(ScanSnapshot const & snapshot)
+{
+    PVStructurePtr pvResult = getPVDataCreate()->createPVStructure(ScanStatus::getStructure());
+    ScanStatus::put(pvResult,snapshot);
     return pvResult;
 }
 
@@ -86,6 +134,7 @@ static StructureConstPtr makeRecordStructure()
             add("positionSP", makePointTopStructure())->
             add("positionRB", makePointTopStructure())->
             add("timeStamp", getStandardField()->timeStamp())->
+            add("history", ScanHistory::getStructure())->
             createStructure();
     }
     return recordStructure;
@@ -96,42 +145,34 @@ void ConfigureService::request(
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
 )
 {
-    PVStructureArrayPtr valueField = args->getSubField<PVStructureArray>("value");
-    if (!valueField) {
-        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
-            "No structure array value field");
-    }
-    StructureConstPtr valueFieldStructure = valueField->
-        getStructureArray()->getStructure();
-
-    ScalarConstPtr xField = valueFieldStructure->getField<Scalar>("x");
-    if (!xField || xField->getScalarType() != pvDouble) {
-        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
-            "value field's structure has no double field x");
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_CONFIGURE);
+    try {
+        scanService->configure(
+            pointDecoder->decode(args));
     }
-    ScalarConstPtr yField = valueFieldStructure->getField<Scalar>("y");
-    if (!yField || yField->getScalarType() != pvDouble)
-        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
-            "value field's structure has no double field y");
-    PVStructureArray::const_svector vals = valueField->view();
-    std::vector<Point> newPoints;
-    newPoints.reserve(vals.size());
-    for (PVStructureArray::const_svector::const_iterator it = vals.begin();
-         it != vals.end(); ++it)
-    {
-        double x = (*it)->getSubFieldT<PVDouble>("x")->get();
-        double y = (*it)->getSubFieldT<PVDouble>("y")->get();
-        newPoints.push_back(Point(x,y));
+    catch (std::exception& e) {
+        throw epics::pvAccess::RPCRequestException(
+            Status::STATUSTYPE_ERROR,e.what());
     }
+    callback->requestDone(Status::Ok,success);
+}
 
+void ConfigureTrajectoryService::request(
+    PVStructure::shared_pointer const & args,
+    epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+)
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_CONFIGURE_TRAJECTORY);
     try {
-        pvRecord->getScanService()->configure(newPoints);
+        scanService->configure(createTrajectory(args));
     }
     catch (std::exception& e) {
         throw epics::pvAccess::RPCRequestException(
             Status::STATUSTYPE_ERROR,e.what());
     }
-    callback->requestDone(Status::Ok,makeResultStructure("configure success"));
+    callback->requestDone(Status::Ok,success);
 }
 
 void StartService::request(
@@ -139,14 +180,16 @@ void StartService::request(
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
 )
 {
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_START);
     try {
-        pvRecord->getScanService()->startScan();
+        scanService->startScan();
     }
     catch (std::exception& e) {
         throw epics::pvAccess::RPCRequestException(
             Status::STATUSTYPE_ERROR,e.what());
     }
-    callback->requestDone(Status::Ok,makeResultStructure("start success"));
+    callback->requestDone(Status::Ok,success);
 }
 
 void StopService::request(
@@ -154,14 +197,16 @@ void StopService::request(
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
 )
 {
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_STOP);
     try {
-        pvRecord->getScanService()->stopScan();
+        scanService->stopScan();
     }
     catch (std::exception& e) {
         throw epics::pvAccess::RPCRequestException(
             Status::STATUSTYPE_ERROR,e.what());
     }
-    callback->requestDone(Status::Ok,makeResultStructure("stop success"));
+    callback->requestDone(Status::Ok,success);
 }
 
 void SetRateService::request(
@@ -169,6 +214,8 @@ void SetRateService::request(
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
 )
 {
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_SET_RATE);
     PVDoublePtr pvStepDelay = args->getSubField<PVDouble>("stepDelay");
     if(!pvStepDelay) {
         throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
@@ -182,13 +229,35 @@ void SetRateService::request(
     double stepDelay = pvStepDelay->get();
     double stepDistance = pvStepDistance->get();
     try {
-        pvRecord->getScanService()->setRate(stepDelay,stepDistance);
+        scanService->setRate(stepDelay,stepDistance);
+    }
+    catch (std::exception& e) {
+        throw epics::pvAccess::RPCRequestException(
+            Status::STATUSTYPE_ERROR,e.what());
+    }
+    callback->requestDone(Status::Ok,success);
+}
+
+void SetPublishRateService::request(
+    PVStructure::shared_pointer const & args,
+    epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+)
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_SET_PUBLISH_RATE);
+    PVDoublePtr pvRate = args->getSubField<PVDouble>("value");
+    if(!pvRate) {
+        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
+            "No value field");
+    }
+    try {
+        publishLimiter->setMaxRate(pvRate->get());
     }
     catch (std::exception& e) {
         throw epics::pvAccess::RPCRequestException(
             Status::STATUSTYPE_ERROR,e.what());
     }
-    callback->requestDone(Status::Ok,makeResultStructure("setRate success"));
+    callback->requestDone(Status::Ok,success);
 }
 
 void SetDebugService::request(
@@ -196,6 +265,8 @@ void SetDebugService::request(
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
 )
 {
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_SET_DEBUG);
     PVBooleanPtr pvDebug = args->getSubField<PVBoolean>("value");
     if(!pvDebug) {
         throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
@@ -203,13 +274,132 @@ void SetDebugService::request(
     }
     bool value = pvDebug->get();
     try {
-        pvRecord->getScanService()->setDebug(value);
+        scanService->setDebug(value);
+    }
+    catch (std::exception& e) {
+        throw epics::pvAccess::RPCRequestException(
+            Status::STATUSTYPE_ERROR,e.what());
+    }
+    callback->requestDone(Status::Ok,success);
+}
+
+void DumpTraceService::request(
+    PVStructure::shared_pointer const & args,
+    epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+)
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_DUMP_TRACE);
+    PVStringPtr pvFileName = args->getSubField<PVString>("fileName");
+    if(!pvFileName) {
+        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
+            "No fileName field");
+    }
+    size_t count = 0;
+    try {
+        count = ScanTrace::getShared()->dumpNamed(pvFileName->get());
     }
     catch (std::exception& e) {
         throw epics::pvAccess::RPCRequestException(
             Status::STATUSTYPE_ERROR,e.what());
     }
-    callback->requestDone(Status::Ok,makeResultStructure("setDebug success"));
+    std::stringstream ss;
+    ss << "dumpTrace wrote " << count << " events";
+    callback->requestDone(Status::Ok,resultFactory->get(ResultFactory::statusOK,ss.str()));
+}
+
+void StatusService::request(
+    PVStructure::shared_pointer const & args,
+    epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+)
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_STATUS);
+    callback->requestDone(Status::Ok,resultFactory->getStatus(scanService->getSnapshot()));
+}
+
+static void addCommand(
+    ScanService::Batch & batch,
+    const string & method,
+    PVStructurePtr const & command,
+    PointDecoderPtr const & pointDecoder)
+{
+    if (method == "configure") {
+        batch.configure(pointDecoder->decode(command));
+    } else if (method == "configureTrajectory") {
+        batch.configure(createTrajectory(command));
+    } else if (method == "start") {
+        batch.startScan();
+    } else if (method == "stop") {
+        batch.stopScan();
+    } else if (method == "setRate") {
+        batch.setRate(
+            command->getSubFieldT<PVDouble>("stepDelay")->get(),
+            command->getSubFieldT<PVDouble>("stepDistance")->get());
+    } else if (method == "setDebug") {
+        batch.setDebug(command->getSubFieldT<PVBoolean>("value")->get());
+    } else {
+        throw std::runtime_error("method " + method + " can not be batched");
+    }
+}
+
+void BatchService::request(
+    PVStructure::shared_pointer const & args,
+    epics::pvAccess::RPCResponseCallback::shared_pointer const & callback
+)
+{
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_BATCH);
+    PVUnionArrayPtr pvCommands = args->getSubField<PVUnionArray>("commands");
+    if(!pvCommands) {
+        throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,
+            "No union array commands field");
+    }
+    // decode everything first so that a bad command runs nothing
+    PVUnionArray::const_svector commands = pvCommands->view();
+    ScanService::Batch batch;
+    std::vector<string> methods;
+    for (size_t i=0; i<commands.size(); ++i)
+    {
+        PVStructurePtr command;
+        if (commands[i]) command = std::tr1::dynamic_pointer_cast<PVStructure>(commands[i]->get());
+        PVStringPtr pvMethod;
+        if (command) pvMethod = command->getSubField<PVString>("method");
+        std::stringstream ss;
+        ss << "command " << i << " ";
+        if(!pvMethod) {
+            ss << "is not a structure with a method field";
+            throw pvAccess::RPCRequestException(Status::STATUSTYPE_ERROR,ss.str());
+        }
+        string method = pvMethod->get();
+        try {
+            addCommand(batch,method,command,pointDecoder);
+        }
+        catch (std::exception& e) {
+            ss << method << " " << e.what();
+            throw epics::pvAccess::RPCRequestException(
+                Status::STATUSTYPE_ERROR,ss.str());
+        }
+        methods.push_back(method);
+    }
+    string error;
+    size_t done = scanService->execute(batch,error);
+    shared_vector<string> results(methods.size());
+    for (size_t i=0; i<methods.size(); ++i)
+    {
+        if (i < done) results[i] = methods[i] + " success";
+        else if (i == done) results[i] = methods[i] + " exception " + error;
+        else results[i] = methods[i] + " not run";
+    }
+    std::stringstream ss;
+    int status = ResultFactory::statusOK;
+    if (done == methods.size()) {
+        ss << "batch success";
+    } else {
+        ss << "batch stopped at command " << done;
+        status = ResultFactory::statusFailed;
+    }
+    callback->requestDone(Status::Ok,resultFactory->getBatch(status,ss.str(),freeze(results)));
 }
 
 ScanRPCService::Callback::shared_pointer ScanRPCService::Callback::create(ScanRPCServicePtr const & service)
@@ -217,36 +407,63 @@ ScanRPCService::Callback::shared_pointer ScanRPCService::Callback::create(ScanRP
     return ScanRPCService::Callback::shared_pointer(new ScanRPCService::Callback(service));
 }
 
+void ScanRPCService::Callback::update(int flags)
+{
+    ScanRPCServicePtr rpcService(service.lock());
+    if (rpcService) rpcService->update(flags);
+}
+
+ScanRPCService::shared_pointer ScanRPCService::create(ScanServicePtr const & scanService)
+{
+    ScanRPCServicePtr service(new ScanRPCService(scanService));
+    service->scanServiceCallback = Callback::create(service);
+    scanService->registerCallback(service->scanServiceCallback);
+    return service;
+}
+
+ScanRPCService::~ScanRPCService()
+{
+    scanService->unregisterCallback(scanServiceCallback);
+}
+
 void ScanRPCService::request(
     PVStructurePtr const & args,
     epics::pvAccess::RPCResponseCallback::shared_pointer const & callback)
 {
-    pvRecord->getScanService()->startScan();
-    ScanRPCService::Callback::shared_pointer cb = ScanRPCService::Callback::create(shared_from_this());
-    this->rpcCallback = callback;
-    this->scanServiceCallback = cb;
-    pvRecord->getScanService()->registerCallback(cb);
+    LatencyTimer timer(scanService->getMetrics()->getServiceTime());
+    scanService->trace(ScanTrace::REQUEST,ScanTrace::REQUEST_SCAN);
+    epics::pvData::Lock lock(mutex);
+    if (waiters.size() >= maxWaiters)
+    {
+        std::stringstream ss;
+        ss << "more than " << maxWaiters << " clients waiting";
+        throw epics::pvAccess::RPCRequestException(
+            Status::STATUSTYPE_ERROR,ss.str());
+    }
+    waiters.push_back(callback);
 }
- 
 
-void ScanRPCService::handleError(const std::string & message)
+size_t ScanRPCService::getWaiterCount()
 {
-    rpcCallback->requestDone(
-        Status(Status::STATUSTYPE_ERROR, std::string(message)),
-        PVStructure::shared_pointer());
-
-    pvRecord->getScanService()->unregisterCallback(
-         scanServiceCallback);
+    epics::pvData::Lock lock(mutex);
+    return waiters.size();
 }
 
-
+// the waiters are answered without holding the mutex
 void ScanRPCService::scanComplete()
 {
-    rpcCallback->requestDone(Status::Ok, makeResultStructure("configure success"));
-    pvRecord->getScanService()->unregisterCallback(scanServiceCallback);
+    std::vector<epics::pvAccess::RPCResponseCallback::shared_pointer> done;
+    {
+        epics::pvData::Lock lock(mutex);
+        if (waiters.empty()) return;
+        done.swap(waiters);
+    }
+    for (size_t i=0; i<done.size(); ++i)
+    {
+        done[i]->requestDone(Status::Ok,complete);
+    }
 }
 
-
 void ScanRPCService::update(int flags)
 {
     if ((flags & ScanService::Callback::SCAN_COMPLETE) != 0)
@@ -255,11 +472,6 @@ void ScanRPCService::update(int flags)
     }
 }
 
-void ScanRPCService::Callback::update(int flags)
-{
-    service->update(flags);
-}
-
 
 ScanServerRPC::Callback::shared_pointer ScanServerRPC::Callback::create(ScanServerRPCPtr const & record)
 {
@@ -273,28 +485,34 @@ void ScanServerRPC::Callback::update(int flags)
 
 void ScanServerRPC::update(int flags)
 {
+    epicsUInt64 start = epicsMonotonicGet();
     lock();
+    scanService->getMetrics()->getLockWait().record(epicsMonotonicGet() - start);
     try {
+        ScanSnapshot snapshot = scanService->getSnapshot();
         TimeStamp timeStamp;
         timeStamp.getCurrent();
         beginGroupPut();
 
         if ((flags & ScanService::Callback::SETPOINT_CHANGED) != 0)
         {
-            Point sp = scanService->getPositionSetpoint();
-            pvx->put(sp.x);
-            pvy->put(sp.y);
+            pvx->put(snapshot.setpoint.x);
+            pvy->put(snapshot.setpoint.y);
             pvTimeStamp_sp.set(timeStamp);
         }
 
         if ((flags & ScanService::Callback::READBACK_CHANGED) != 0)
         {
-            Point rb = scanService->getPositionReadback();
-            pvx_rb->put(rb.x);
-            pvy_rb->put(rb.y);
+            pvx_rb->put(snapshot.readback.x);
+            pvy_rb->put(snapshot.readback.y);
             pvTimeStamp_rb.set(timeStamp);
         }
 
+        if ((flags & ScanService::Callback::HISTORY_CHANGED) != 0)
+        {
+            scanHistory->put();
+        }
+
         pvTimeStamp.set(timeStamp);
         endGroupPut();
     }
@@ -339,6 +557,10 @@ ScanServerRPC::ScanServerRPC(
     pvTimeStamp_sp.attach(pvStructure->getSubFieldT<PVStructure>("positionSP.timeStamp"));
     pvTimeStamp_rb.attach(pvStructure->getSubFieldT<PVStructure>("positionRB.timeStamp"));
     scanService = ScanService::create();
+    scanHistory = ScanHistory::create(
+        pvStructure->getSubFieldT<PVStructure>("history"),scanService->getHistory());
+    pointDecoder = PointDecoder::create();
+    resultFactory = ResultFactory::create();
 }
 
 void ScanServerRPC::initPvt()
@@ -348,43 +570,75 @@ void ScanServerRPC::initPvt()
     PVFieldPtr pvField;
     pvTimeStamp.attach(getPVStructure()->getSubField("timeStamp"));
 
-    scanService->registerCallback(Callback::create(std::tr1::dynamic_pointer_cast<ScanServerRPC>(shared_from_this())));
+    publishLimiter = PublishLimiter::create(
+        Callback::create(std::tr1::dynamic_pointer_cast<ScanServerRPC>(shared_from_this())),
+        scanService->getExecutor());
+    scanService->registerCallback(publishLimiter);
+
+    // the services hold the scan service, not the record, so there is no cycle
+    registerService("configure",ConfigureService::create(scanService,pointDecoder));
+    registerService("configureTrajectory",ConfigureTrajectoryService::create(scanService));
+    registerService("start",StartService::create(scanService));
+    registerService("stop",StopService::create(scanService));
+    registerService("setRate",SetRateService::create(scanService));
+    registerService("setDebug",SetDebugService::create(scanService));
+    registerService("setPublishRate",SetPublishRateService::create(scanService,publishLimiter));
+    registerService("dumpTrace",DumpTraceService::create(scanService,resultFactory));
+    registerService("batch",BatchService::create(scanService,pointDecoder,resultFactory));
+    registerService("waitComplete",ScanRPCService::create(scanService));
+    registerService("status",StatusService::create(scanService,resultFactory));
 
     process();
 }
 
-epics::pvAccess::RPCServiceAsync::shared_pointer ScanServerRPC::getService(
-        PVStructurePtr const & pvRequest)
+// FNV-1a
+static size_t hashMethod(const string & method)
 {
-    PVStringPtr methodField = pvRequest->getSubField<PVString>("method");
+    epicsUInt32 hash = 2166136261u;
+    for (size_t i=0; i<method.size(); ++i)
+    {
+        hash ^= static_cast<unsigned char>(method[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-    if (methodField.get() != 0)
+void ScanServerRPC::registerService(
+    string const & method,
+    epics::pvAccess::RPCServiceAsync::shared_pointer const & service)
+{
+    size_t hash = hashMethod(method);
+    epics::pvData::Lock lock(methodMutex);
+    std::vector<MethodEntry> & bucket = methodTable[hash%methodTableSize];
+    for (size_t i=0; i<bucket.size(); ++i)
     {
-        std::string method = methodField->get();
-        if (method == "configure")
+        if (bucket[i].hash == hash && bucket[i].method == method)
         {
-            return ConfigureService::create(
-                 std::tr1::dynamic_pointer_cast<ScanServerRPC>(
-                 shared_from_this()));
-        } else if (method == "start") {
-            return StartService::create(
-                 std::tr1::dynamic_pointer_cast<ScanServerRPC>(
-                 shared_from_this()));
-        } else if (method == "stop") {
-            return StopService::create(
-                 std::tr1::dynamic_pointer_cast<ScanServerRPC>(
-                 shared_from_this()));
-        } else if (method == "setRate") {
-            return SetRateService::create(
-                 std::tr1::dynamic_pointer_cast<ScanServerRPC>(
-                 shared_from_this()));
-        } else if (method == "setDebug") {
-            return SetDebugService::create(
-                 std::tr1::dynamic_pointer_cast<ScanServerRPC>(
-                 shared_from_this()));
+            bucket[i].service = service;
+            return;
         }
     }
-    return epics::pvAccess::RPCService::shared_pointer();
+    MethodEntry entry;
+    entry.hash = hash;
+    entry.method = method;
+    entry.service = service;
+    bucket.push_back(entry);
+}
+
+epics::pvAccess::RPCServiceAsync::shared_pointer ScanServerRPC::getService(
+        PVStructurePtr const & pvRequest)
+{
+    PVStringPtr methodField = pvRequest->getSubField<PVString>("method");
+    if (!methodField) return epics::pvAccess::RPCServiceAsync::shared_pointer();
+    const string & method = methodField->get();
+    size_t hash = hashMethod(method);
+    epics::pvData::Lock lock(methodMutex);
+    const std::vector<MethodEntry> & bucket = methodTable[hash%methodTableSize];
+    for (size_t i=0; i<bucket.size(); ++i)
+    {
+        if (bucket[i].hash == hash && bucket[i].method == method) return bucket[i].service;
+    }
+    return epics::pvAccess::RPCServiceAsync::shared_pointer();
 }
 
 void ScanServerRPC::process()
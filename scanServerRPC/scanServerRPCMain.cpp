@@ -13,6 +13,7 @@
 #include <iostream>
 
 #include <pv/scanServerRPC.h>
+#include <pv/scanStatsRecord.h>
 #include <pv/channelProviderLocal.h>
 
 using namespace std;
@@ -29,7 +30,9 @@ int main(int argc,char *argv[])
     string recordName;
 
     recordName = "scanServerRPC";
-    pvRecord = ScanServerRPC::create(recordName);
+    ScanServerRPCPtr record = ScanServerRPC::create(recordName);
+    master->addRecord(record);
+    pvRecord = ScanStatsRecord::create(recordName + ":stats",record->getScanService());
     master->addRecord(pvRecord);
 
     ServerContext::shared_pointer ctx =
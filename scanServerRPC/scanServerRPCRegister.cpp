@@ -28,6 +28,7 @@
 #include <pv/pvAccess.h>
 #include <pv/pvDatabase.h>
 #include <pv/scanService.h>
+#include <pv/scanStatsRecord.h>
 
 #include <epicsExport.h>
 #include "pv/scanServerRPC.h"
@@ -37,6 +38,7 @@ using namespace epics::pvAccess;
 using namespace epics::pvDatabase;
 using namespace epics::exampleScan;
 using std::cout;
+using std::string;
 using std::endl;
 
 static const iocshArg testArg0 = { "recordName", iocshArgString };
@@ -52,6 +54,10 @@ static void scanServerRPCCallFunc(const iocshArgBuf *args)
     ScanServerRPCPtr record = ScanServerRPC::create(recordName);
     bool result = master->addRecord(record);
     if(!result) cout << "recordname" << " not added" << endl;
+    ScanStatsRecordPtr statsRecord = ScanStatsRecord::create(
+        string(recordName) + ":stats",record->getScanService());
+    result = master->addRecord(statsRecord);
+    if(!result) cout << "stats record" << " not added" << endl;
 }
 
 static void scanServerRPCRegister(void)
@@ -0,0 +1,150 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <epicsExport.h>
+#include "pv/pointCodec.h"
+
+using namespace epics::pvData;
+
+namespace epics { namespace exampleScan {
+
+static const double int32Min = -2147483648.0;
+static const double int32Max = 2147483647.0;
+static const size_t maxVarint = 10;
+
+// false for zero, negative, infinite and NaN
+static bool validScale(double scale)
+{
+    return scale > 0.0 && scale <= DBL_MAX;
+}
+
+// every value takes at least one byte, so a larger count is rejected
+// before anything is allocated for it
+static void checkDecode(size_t length,size_t count,double scale)
+{
+    if (!validScale(scale)) throw std::runtime_error("PointCodec scale must be finite and positive");
+    if (count > length) throw std::runtime_error("PointCodec count is larger than the stream");
+}
+
+shared_vector<const epicsUInt8> PointCodec::encode(
+    shared_vector<const double> const & values,
+    double scale,double offset)
+{
+    if (!validScale(scale)) throw std::invalid_argument("PointCodec scale must be finite and positive");
+    // one byte per value is the common case; grow by doubling otherwise,
+    // shared_vector::push_back grows by one element at a time
+    shared_vector<epicsUInt8> stream(values.size() + maxVarint);
+    size_t pos = 0;
+    epicsInt64 previous = 0;
+    epicsInt64 previousDelta = 0;
+    for (size_t i=0; i<values.size(); ++i)
+    {
+        double quantized = floor((values[i] - offset)/scale + 0.5);
+        if (!(quantized >= int32Min && quantized <= int32Max))
+        {
+            throw std::invalid_argument("PointCodec value does not fit scale and offset");
+        }
+        epicsInt64 q = static_cast<epicsInt64>(quantized);
+        epicsInt64 delta = q - previous;
+        epicsInt64 deltaOfDelta = delta - previousDelta;
+        previous = q;
+        previousDelta = delta;
+        epicsUInt64 zigzag = (static_cast<epicsUInt64>(deltaOfDelta) << 1)
+            ^ static_cast<epicsUInt64>(deltaOfDelta >> 63);
+        if (pos + maxVarint > stream.size()) stream.resize(2*stream.size());
+        while (zigzag >= 0x80)
+        {
+            stream[pos++] = static_cast<epicsUInt8>(zigzag | 0x80);
+            zigzag >>= 7;
+        }
+        stream[pos++] = static_cast<epicsUInt8>(zigzag);
+    }
+    stream.resize(pos);
+    return freeze(stream);
+}
+
+static void truncated()
+{
+    throw std::runtime_error("PointCodec stream is truncated");
+}
+
+void PointCodec::decode(
+    const epicsUInt8 * stream,size_t length,size_t count,
+    double scale,double offset,double * values)
+{
+    checkDecode(length,count,scale);
+    // pass 1: the second differences, as doubles so no temporary is needed;
+    // they are exact since a valid stream has them well inside 2^53
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < count)
+    {
+        if (pos + 8 <= length && i + 8 <= count)
+        {
+            epicsUInt64 word;
+            memcpy(&word,stream + pos,8);
+            if ((word & 0x8080808080808080ULL) == 0)
+            {
+                for (size_t k=0; k<8; ++k)
+                {
+                    int b = stream[pos + k];
+                    values[i + k] = (b >> 1) ^ -(b & 1);
+                }
+                pos += 8;
+                i += 8;
+                continue;
+            }
+        }
+        epicsUInt64 zigzag = 0;
+        int shift = 0;
+        while (true)
+        {
+            if (pos >= length) truncated();
+            epicsUInt8 b = stream[pos++];
+            zigzag |= static_cast<epicsUInt64>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) break;
+            shift += 7;
+            if (shift > 63) throw std::runtime_error("PointCodec varint is too long");
+        }
+        values[i++] = static_cast<double>(static_cast<epicsInt64>(
+            (zigzag >> 1) ^ (0 - (zigzag & 1))));
+    }
+    if (pos != length) throw std::runtime_error("PointCodec stream is longer than count values");
+    // pass 2: integrate twice
+    double delta = 0.0;
+    double q = 0.0;
+    for (i=0; i<count; ++i)
+    {
+        delta += values[i];
+        q += delta;
+        if (!(q >= int32Min && q <= int32Max))
+        {
+            throw std::runtime_error("PointCodec value is out of range");
+        }
+        values[i] = q;
+    }
+    // pass 3: independent per value, so the compiler vectorizes it
+    for (i=0; i<count; ++i) values[i] = values[i]*scale + offset;
+}
+
+shared_vector<const double> PointCodec::decode(
+    shared_vector<const epicsUInt8> const & stream,size_t count,
+    double scale,double offset)
+{
+    checkDecode(stream.size(),count,scale);
+    shared_vector<double> values(count);
+    decode(stream.data(),stream.size(),count,scale,offset,values.data());
+    return freeze(values);
+}
+
+}}
@@ -0,0 +1,148 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <stdexcept>
+#include <pv/pvDatabase.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+#include "pv/pointDecoder.h"
+
+using namespace epics::pvData;
+using std::string;
+
+namespace epics { namespace exampleScan {
+
+PointDecoderPtr PointDecoder::create()
+{
+    return PointDecoderPtr(new PointDecoder());
+}
+
+PointDecoder::PointDecoder()
+: xIndex(0),
+  yIndex(0)
+{
+}
+
+static size_t getDoubleIndex(StructureConstPtr const & structure,const string & name)
+{
+    size_t index = structure->getFieldIndex(name);
+    if (index < structure->getNumberFields())
+    {
+        FieldConstPtr field = structure->getField(index);
+        if (field->getType() == scalar &&
+            std::tr1::static_pointer_cast<const Scalar>(field)->getScalarType() == pvDouble)
+        {
+            return index;
+        }
+    }
+    throw std::runtime_error("value field's structure has no double field " + name);
+}
+
+void PointDecoder::getIndexes(StructureConstPtr const & elementStructure,size_t & x,size_t & y)
+{
+    epics::pvData::Lock lock(mutex);
+    // a client sends the same introspection interface every time
+    if (elementStructure != structure)
+    {
+        xIndex = getDoubleIndex(elementStructure,"x");
+        yIndex = getDoubleIndex(elementStructure,"y");
+        structure = elementStructure;
+    }
+    x = xIndex;
+    y = yIndex;
+}
+
+static StructureConstPtr encodedStructure;
+static epicsThreadOnceId encodedOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createEncodedStructure(void *)
+{
+    encodedStructure = getFieldCreate()->createFieldBuilder()->
+        setId("encodedPoints_t")->
+        add("scale",pvDouble)->
+        add("xOffset",pvDouble)->
+        add("yOffset",pvDouble)->
+        add("count",pvInt)->
+        addArray("x",pvUByte)->
+        addArray("y",pvUByte)->
+        createStructure();
+}
+
+StructureConstPtr PointDecoder::getEncodedStructure()
+{
+    epicsThreadOnce(&encodedOnce,createEncodedStructure,0);
+    return encodedStructure;
+}
+
+template<typename PVT>
+static std::tr1::shared_ptr<PVT> getEncodedField(PVStructurePtr const & encoded,const char * name)
+{
+    std::tr1::shared_ptr<PVT> field = encoded->getSubField<PVT>(name);
+    if (!field) throw std::runtime_error(string("encoded has no valid field ") + name);
+    return field;
+}
+
+ScanPlanPtr PointDecoder::decodeEncoded(PVStructurePtr const & encoded)
+{
+    return decodeEncoded(
+        getEncodedField<PVDouble>(encoded,"scale")->get(),
+        getEncodedField<PVDouble>(encoded,"xOffset")->get(),
+        getEncodedField<PVDouble>(encoded,"yOffset")->get(),
+        getEncodedField<PVInt>(encoded,"count")->get(),
+        getEncodedField<PVUByteArray>(encoded,"x")->view(),
+        getEncodedField<PVUByteArray>(encoded,"y")->view());
+}
+
+ScanPlanPtr PointDecoder::decodeEncoded(
+    double scale,double xOffset,double yOffset,int32 count,
+    shared_vector<const uint8> const & x,
+    shared_vector<const uint8> const & y)
+{
+    if (count < 0) throw std::runtime_error("encoded count is negative");
+    return PointListPlan::create(
+        PointCodec::decode(x,count,scale,xOffset),
+        PointCodec::decode(y,count,scale,yOffset));
+}
+
+ScanPlanPtr PointDecoder::decode(PVStructurePtr const & args)
+{
+    PVStructureArrayPtr value = args->getSubField<PVStructureArray>("value");
+    if (!value)
+    {
+        PVStructurePtr encoded = args->getSubField<PVStructure>("encoded");
+        if (encoded) return decodeEncoded(encoded);
+        PVDoubleArrayPtr pvx = args->getSubField<PVDoubleArray>("x");
+        PVDoubleArrayPtr pvy = args->getSubField<PVDoubleArray>("y");
+        if (!pvx || !pvy)
+        {
+            throw std::runtime_error(
+                "No structure array value field, no encoded field and no double array fields x and y");
+        }
+        return PointListPlan::create(pvx->view(),pvy->view());
+    }
+    size_t ix = 0;
+    size_t iy = 0;
+    getIndexes(value->getStructureArray()->getStructure(),ix,iy);
+    PVStructureArray::const_svector elements = value->view();
+    size_t npoints = elements.size();
+    shared_vector<double> x(npoints);
+    shared_vector<double> y(npoints);
+    for (size_t i=0; i<npoints; ++i)
+    {
+        const PVStructure * element = elements[i].get();
+        if (!element) throw std::runtime_error("value has a null element");
+        // every element has the structure of the array so the indexes hold
+        const PVFieldPtrArray & fields = element->getPVFields();
+        x[i] = static_cast<const PVDouble *>(fields[ix].get())->get();
+        y[i] = static_cast<const PVDouble *>(fields[iy].get())->get();
+    }
+    return PointListPlan::create(freeze(x),freeze(y));
+}
+
+}}
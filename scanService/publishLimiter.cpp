@@ -0,0 +1,131 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <stdexcept>
+#include <epicsExport.h>
+#include "pv/publishLimiter.h"
+
+namespace epics { namespace exampleScan {
+
+class PublishLimiter::FlushTask : public ScanExecutor::Task
+{
+public:
+    FlushTask(PublishLimiter::weak_pointer const & limiter)
+    : limiter(limiter)
+    {}
+    virtual void execute()
+    {
+        PublishLimiterPtr publishLimiter(limiter.lock());
+        if (publishLimiter) publishLimiter->flush();
+    }
+private:
+    PublishLimiter::weak_pointer limiter;
+};
+
+// runs on a worker when the interval ends and passes the flush on to
+// a dispatch thread, so publishing never takes time from the steps
+class PublishLimiter::DueTask : public ScanExecutor::Task
+{
+public:
+    DueTask(ScanExecutorPtr const & executor,ScanExecutor::Task::shared_pointer const & flushTask)
+    : executor(executor),
+      flushTask(flushTask)
+    {}
+    virtual void execute() { executor->submit(flushTask); }
+private:
+    ScanExecutorPtr executor;
+    ScanExecutor::Task::shared_pointer flushTask;
+};
+
+PublishLimiterPtr PublishLimiter::create(
+    ScanService::Callback::shared_pointer const & target,
+    ScanExecutorPtr const & executor)
+{
+    PublishLimiterPtr limiter(new PublishLimiter(target,executor));
+    limiter->dueTask = std::tr1::shared_ptr<DueTask>(new DueTask(
+        executor,ScanExecutor::Task::shared_pointer(new FlushTask(limiter))));
+    return limiter;
+}
+
+PublishLimiter::PublishLimiter(
+    ScanService::Callback::shared_pointer const & target,
+    ScanExecutorPtr const & executor)
+: target(target),
+  executor(executor),
+  maxRate(0.0),
+  intervalNs(0),
+  lastPublish(0),
+  pending(0),
+  flushScheduled(false)
+{
+}
+
+void PublishLimiter::setMaxRate(double value)
+{
+    if (value < 0.0) throw std::invalid_argument("publish rate must not be negative");
+    epics::pvData::Lock lock(mutex);
+    maxRate = value;
+    intervalNs = (value > 0.0) ? static_cast<epicsUInt64>(1e9/value) : 0;
+}
+
+double PublishLimiter::getMaxRate()
+{
+    epics::pvData::Lock lock(mutex);
+    return maxRate;
+}
+
+// publishMutex is held from the decision to the end of the call into the
+// target, so direct updates and flushes reach the target in the order
+// they were decided. mutex alone is released first, since a record that
+// holds its lock may call setMaxRate.
+void PublishLimiter::update(int flags)
+{
+    epics::pvData::Lock publishLock(publishMutex);
+    int publish = 0;
+    bool schedule = false;
+    epicsUInt64 deadline = 0;
+    {
+        epics::pvData::Lock lock(mutex);
+        pending |= flags;
+        epicsUInt64 now = executor->now();
+        if (intervalNs == 0
+        || (flags & ScanService::Callback::SCAN_COMPLETE) != 0
+        || now >= lastPublish + intervalNs)
+        {
+            publish = pending;
+            pending = 0;
+            lastPublish = now;
+        }
+        else if (!flushScheduled)
+        {
+            flushScheduled = true;
+            schedule = true;
+            deadline = lastPublish + intervalNs;
+        }
+    }
+    if (schedule) executor->schedule(dueTask,deadline);
+    if (publish != 0) target->update(publish);
+}
+
+// the end of an interval; anything that arrived during it goes out now
+void PublishLimiter::flush()
+{
+    epics::pvData::Lock publishLock(publishMutex);
+    int publish = 0;
+    {
+        epics::pvData::Lock lock(mutex);
+        flushScheduled = false;
+        publish = pending;
+        pending = 0;
+        if (publish != 0) lastPublish = executor->now();
+    }
+    if (publish != 0) target->update(publish);
+}
+
+}}
@@ -0,0 +1,134 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef CALLBACKREGISTRY_H
+#define CALLBACKREGISTRY_H
+
+#include <vector>
+#include <algorithm>
+#include <pv/pvDatabase.h>
+#include <epicsAtomic.h>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * A list of callbacks that can be walked without copying or locking.
+ * Writers build a new immutable list and swap it in atomically.
+ * A replaced list is deleted at once if the reader is not walking a list,
+ * otherwise it is kept until the reader calls release.
+ *
+ * There must be at most one reader at a time, which calls acquire,
+ * walks the list and then calls release.
+ * Writers may be called from any thread.
+ */
+template<class T>
+class CallbackRegistry
+{
+public:
+    typedef std::vector<T> List;
+
+    CallbackRegistry()
+    : current(new List()),
+      readers(0),
+      retiredCount(0)
+    {}
+    ~CallbackRegistry()
+    {
+        delete static_cast<List*>(current);
+        reclaim();
+    }
+    /**
+     * Add an item.
+     * @return false if the item is already registered.
+     */
+    bool add(T const & item)
+    {
+        epics::pvData::Lock lock(writeMutex);
+        const List & list = *static_cast<const List*>(current);
+        if (std::find(list.begin(),list.end(),item) != list.end()) return false;
+        List * newList = new List();
+        newList->reserve(list.size() + 1);
+        newList->insert(newList->end(),list.begin(),list.end());
+        newList->push_back(item);
+        swap(newList);
+        return true;
+    }
+    /**
+     * Remove an item.
+     * @return false if the item was not registered.
+     */
+    bool remove(T const & item)
+    {
+        epics::pvData::Lock lock(writeMutex);
+        const List & list = *static_cast<const List*>(current);
+        typename List::const_iterator found = std::find(list.begin(),list.end(),item);
+        if (found == list.end()) return false;
+        List * newList = new List();
+        newList->reserve(list.size() - 1);
+        newList->insert(newList->end(),list.begin(),found);
+        newList->insert(newList->end(),found + 1,list.end());
+        swap(newList);
+        return true;
+    }
+    size_t size()
+    {
+        epics::pvData::Lock lock(writeMutex);
+        return static_cast<const List*>(current)->size();
+    }
+    /**
+     * Get the current list.
+     * It stays valid until release is called.
+     */
+    const List & acquire()
+    {
+        epicsAtomicIncrIntT(&readers);
+        return *static_cast<const List*>(epicsAtomicGetPtrT(&current));
+    }
+    /**
+     * Tell the registry that the reader no longer uses any list.
+     */
+    void release()
+    {
+        epicsAtomicDecrIntT(&readers);
+        if (epicsAtomicGetSizeT(&retiredCount) == 0) return;
+        epics::pvData::Lock lock(writeMutex);
+        reclaim();
+    }
+private:
+    CallbackRegistry(const CallbackRegistry &);
+    CallbackRegistry & operator=(const CallbackRegistry &);
+
+    // caller must hold writeMutex
+    void swap(List * newList)
+    {
+        List * oldList = static_cast<List*>(current);
+        // the swap and the increment in acquire are full barriers,
+        // so either the reader is seen or it will load newList
+        epicsAtomicCmpAndSwapPtrT(&current,oldList,newList);
+        retired.push_back(oldList);
+        epicsAtomicIncrSizeT(&retiredCount);
+        if (epicsAtomicGetIntT(&readers) == 0) reclaim();
+    }
+    void reclaim()
+    {
+        for (size_t i=0; i<retired.size(); ++i) delete retired[i];
+        retired.clear();
+        epicsAtomicSetSizeT(&retiredCount,0);
+    }
+
+    EpicsAtomicPtrT current;
+    int readers;
+    size_t retiredCount;
+    std::vector<List*> retired;
+    epics::pvData::Mutex writeMutex;
+};
+
+}}
+
+#endif //CALLBACKREGISTRY_H
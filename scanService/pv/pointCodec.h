@@ -0,0 +1,56 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef POINTCODEC_H
+#define POINTCODEC_H
+
+#include <pv/pvDatabase.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * A compact encoding of one coordinate of a point list.
+ * Each value is quantized to an int32 q = round((value - offset)/scale).
+ * The stream holds the second difference of q, the first difference
+ * of the first differences, zigzag mapped and written as a LEB128 varint.
+ * For a regular grid or a smooth trajectory most second differences are
+ * zero or small, so most values take one byte instead of eight.
+ * The encoding is lossy: a decoded value is within scale/2 of the original.
+ */
+class epicsShareClass PointCodec
+{
+public:
+    /**
+     * @throws std::invalid_argument if scale is not finite and positive
+     * or a value does not quantize to an int32.
+     */
+    static epics::pvData::shared_vector<const epicsUInt8> encode(
+        epics::pvData::shared_vector<const double> const & values,
+        double scale,double offset);
+    /**
+     * Decode count values of a stream into values.
+     * Runs of one byte varints are decoded eight at a time.
+     * @throws std::runtime_error if scale is not finite and positive,
+     * if the stream does not hold exactly count values
+     * or if a value is out of the int32 range.
+     * count is checked against the length before values are allocated.
+     */
+    static void decode(
+        const epicsUInt8 * stream,size_t length,size_t count,
+        double scale,double offset,double * values);
+    static epics::pvData::shared_vector<const double> decode(
+        epics::pvData::shared_vector<const epicsUInt8> const & stream,size_t count,
+        double scale,double offset);
+};
+
+}}
+
+#endif //POINTCODEC_H
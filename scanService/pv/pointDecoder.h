@@ -0,0 +1,76 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef POINTDECODER_H
+#define POINTDECODER_H
+
+#include <pv/pvDatabase.h>
+#include <pv/scanService.h>
+#include <pv/pointCodec.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class PointDecoder;
+typedef std::tr1::shared_ptr<PointDecoder> PointDecoderPtr;
+
+/**
+ * Decodes the points argument of the configure method.
+ * Three forms are accepted:
+ * value, an array of structures that each have double fields x and y,
+ * x and y, two double arrays of the same length,
+ * or encoded, a structure with the layout of getEncodedStructure.
+ * The arrays of the second form are shared with the plan, not copied.
+ * For the first form the index of x and y in the element structure is
+ * looked up once per introspection Structure, not once per point.
+ */
+class epicsShareClass PointDecoder
+{
+public:
+    POINTER_DEFINITIONS(PointDecoder);
+    static PointDecoderPtr create();
+    /**
+     * @throws std::runtime_error if args has neither form.
+     */
+    ScanPlanPtr decode(epics::pvData::PVStructurePtr const & args);
+    /**
+     * The introspection interface of the encoded form, created once:
+     * double scale, xOffset and yOffset, int count,
+     * and ubyte arrays x and y with the PointCodec streams.
+     */
+    static epics::pvData::StructureConstPtr getEncodedStructure();
+    /**
+     * Decode a structure of the encoded form.
+     * @throws std::runtime_error if a field is missing or a stream is bad.
+     */
+    static ScanPlanPtr decodeEncoded(epics::pvData::PVStructurePtr const & encoded);
+    /**
+     * Decode the values of the fields of the encoded form,
+     * for a caller that holds the fields.
+     * @throws std::runtime_error if count is negative or a stream is bad.
+     */
+    static ScanPlanPtr decodeEncoded(
+        double scale,double xOffset,double yOffset,epics::pvData::int32 count,
+        epics::pvData::shared_vector<const epics::pvData::uint8> const & x,
+        epics::pvData::shared_vector<const epics::pvData::uint8> const & y);
+private:
+    PointDecoder();
+    void getIndexes(
+        epics::pvData::StructureConstPtr const & structure,
+        size_t & x, size_t & y);
+
+    epics::pvData::Mutex mutex;
+    epics::pvData::StructureConstPtr structure;
+    size_t xIndex;
+    size_t yIndex;
+};
+
+}}
+
+#endif //POINTDECODER_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef PUBLISHLIMITER_H
+#define PUBLISHLIMITER_H
+
+#include <pv/pvDatabase.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+#include <pv/scanService.h>
+#include <pv/scanExecutor.h>
+
+namespace epics { namespace exampleScan {
+
+class PublishLimiter;
+typedef std::tr1::shared_ptr<PublishLimiter> PublishLimiterPtr;
+
+/**
+ * A callback that passes updates on to another callback at most
+ * maxRate times a second, so a scan can step faster than its record publishes.
+ * Flags that arrive within an interval are merged and passed on when it ends.
+ * The target reads the snapshot when it is called, so the latest state
+ * always wins and the last position of a scan always goes out.
+ * SCAN_COMPLETE is passed on at once, together with anything pending.
+ * A maxRate of 0, the default, passes every update on.
+ * Updates and flushes call the target one at a time, in the order
+ * they were decided, so a flush never lands after a newer update.
+ */
+class epicsShareClass PublishLimiter : public ScanService::Callback
+{
+public:
+    POINTER_DEFINITIONS(PublishLimiter);
+    /**
+     * @param executor The executor that runs the end of interval flush
+     * on a dispatch thread, normally the executor of the scan service.
+     */
+    static PublishLimiterPtr create(
+        ScanService::Callback::shared_pointer const & target,
+        ScanExecutorPtr const & executor);
+    virtual void update(int flags);
+    /**
+     * @throws std::invalid_argument if maxRate is negative.
+     */
+    void setMaxRate(double maxRate);
+    double getMaxRate();
+private:
+    class FlushTask;
+    class DueTask;
+    PublishLimiter(
+        ScanService::Callback::shared_pointer const & target,
+        ScanExecutorPtr const & executor);
+    void flush();
+
+    ScanService::Callback::shared_pointer target;
+    ScanExecutorPtr executor;
+    std::tr1::shared_ptr<DueTask> dueTask;
+    // serializes the calls into target
+    epics::pvData::Mutex publishMutex;
+    epics::pvData::Mutex mutex;
+    double maxRate;
+    epicsUInt64 intervalNs;
+    epicsUInt64 lastPublish;
+    int pending;
+    bool flushScheduled;
+};
+
+}}
+
+#endif //PUBLISHLIMITER_H
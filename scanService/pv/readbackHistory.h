@@ -0,0 +1,91 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef READBACKHISTORY_H
+#define READBACKHISTORY_H
+
+#include <vector>
+#include <pv/pvDatabase.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * A completed block of readback samples.
+ * The arrays are frozen so a block can be shared without copying.
+ * time is in seconds past the POSIX epoch.
+ */
+class HistoryBlock
+{
+public:
+    HistoryBlock()
+    : sequence(0)
+    {}
+    epicsUInt64 sequence;
+    epics::pvData::shared_vector<const double> x;
+    epics::pvData::shared_vector<const double> y;
+    epics::pvData::shared_vector<const double> time;
+};
+
+class ReadbackHistory;
+typedef std::tr1::shared_ptr<ReadbackHistory> ReadbackHistoryPtr;
+
+/**
+ * The readback positions of a scan service, kept as blocks of samples.
+ * The writer fills a block without locking. When the block is full
+ * it is put in a ring of the last blockCount blocks and gets the next
+ * sequence number, so a reader that falls behind sees a gap in the
+ * sequence rather than a silent loss.
+ */
+class epicsShareClass ReadbackHistory
+{
+public:
+    POINTER_DEFINITIONS(ReadbackHistory);
+    static ReadbackHistoryPtr create(size_t blockSize,size_t blockCount);
+    /**
+     * Append a sample.
+     * There must be one writer at a time; the scan service calls add
+     * and flush while holding its mutex.
+     * @return true if the sample completed a block.
+     */
+    bool add(double x,double y,double time);
+    /**
+     * Complete a partly filled block, at the end of a scan.
+     * @return true if there was a partly filled block.
+     */
+    bool flush();
+    /**
+     * Get the completed blocks with a sequence number of at least since
+     * that are still in the ring, oldest first.
+     * @return The sequence number the next block will have.
+     */
+    epicsUInt64 getBlocks(epicsUInt64 since,std::vector<HistoryBlock> & blocks);
+    size_t getBlockSize() const { return blockSize; }
+    size_t getBlockCount() const { return ring.size(); }
+private:
+    ReadbackHistory(size_t blockSize,size_t blockCount);
+    void allocate();
+    void complete();
+
+    const size_t blockSize;
+    // the block the writer is filling
+    epics::pvData::shared_vector<double> x;
+    epics::pvData::shared_vector<double> y;
+    epics::pvData::shared_vector<double> time;
+    size_t filled;
+
+    epics::pvData::Mutex mutex;
+    std::vector<HistoryBlock> ring;
+    epicsUInt64 nextSequence;
+};
+
+}}
+
+#endif //READBACKHISTORY_H
@@ -0,0 +1,69 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANCLOCK_H
+#define SCANCLOCK_H
+
+#include <pv/pvDatabase.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanClock;
+typedef std::tr1::shared_ptr<ScanClock> ScanClockPtr;
+
+class VirtualClock;
+typedef std::tr1::shared_ptr<VirtualClock> VirtualClockPtr;
+
+/**
+ * The time base of a scan executor, in nanoseconds.
+ */
+class epicsShareClass ScanClock
+{
+public:
+    POINTER_DEFINITIONS(ScanClock);
+    virtual ~ScanClock() {}
+    virtual epicsUInt64 now() = 0;
+    /**
+     * Get the clock that reads epicsMonotonicGet.
+     */
+    static ScanClockPtr getMonotonic();
+};
+
+/**
+ * A clock that only moves when it is set.
+ * A virtual executor sets it to the deadline of each task it runs,
+ * so scans run as fast as the CPU allows.
+ * It must only be used by the thread that runs the virtual executor.
+ */
+class epicsShareClass VirtualClock : public ScanClock
+{
+public:
+    POINTER_DEFINITIONS(VirtualClock);
+    static VirtualClockPtr create(epicsUInt64 start = 0)
+    {
+        return VirtualClockPtr(new VirtualClock(start));
+    }
+    virtual epicsUInt64 now() { return time; }
+    /**
+     * Move the clock. It never moves backwards.
+     */
+    void set(epicsUInt64 value) { if (value > time) time = value; }
+    void advance(epicsUInt64 delta) { time += delta; }
+private:
+    VirtualClock(epicsUInt64 start)
+    : time(start)
+    {}
+    epicsUInt64 time;
+};
+
+}}
+
+#endif //SCANCLOCK_H
@@ -0,0 +1,133 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANEXECUTOR_H
+#define SCANEXECUTOR_H
+
+#include <deque>
+#include <vector>
+#include <pv/pvDatabase.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+#include <pv/scanClock.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanExecutor;
+typedef std::tr1::shared_ptr<ScanExecutor> ScanExecutorPtr;
+
+/**
+ * Runs tasks of many scan services on a fixed number of worker threads.
+ * Timed tasks are kept in a hashed timer wheel that is advanced by one
+ * timer thread. The timer sleeps until the next slot that has entries,
+ * and for as long as no task is scheduled.
+ * Due tasks are put on a ready queue that the workers take tasks from.
+ * Submitted tasks, the callbacks of the scan services, run on separate
+ * dispatch threads, so a slow subscriber never delays a step.
+ * The timer wheel has a tick of SCAN_EXECUTOR_TICK, and a step runs
+ * up to one tick after its deadline.
+ *
+ * A virtual executor has no threads. Its tasks are run by the caller
+ * of runNext or runUntil, which move a VirtualClock to the deadline of
+ * each task, so scans run as fast as the CPU allows and a scan posts
+ * the same sequence of updates as in real time. Callbacks may see those
+ * updates merged differently, since merging depends on timing.
+ */
+class epicsShareClass ScanExecutor
+{
+public:
+    POINTER_DEFINITIONS(ScanExecutor);
+    class Task
+    {
+    public:
+        POINTER_DEFINITIONS(Task);
+        virtual ~Task() {}
+        virtual void execute() = 0;
+    };
+    /**
+     * Get the executor shared by all scan services of the process.
+     * It is created on first use. Environment variable
+     * SCAN_EXECUTOR_WORKERS sets the number of workers (default 2),
+     * SCAN_EXECUTOR_DISPATCHERS the number of dispatch threads (default 1)
+     * and SCAN_EXECUTOR_TICK the wheel tick in seconds (default .0001).
+     */
+    static ScanExecutorPtr getShared();
+    static ScanExecutorPtr create(size_t workers,double tick,size_t dispatchers = 1);
+    static ScanExecutorPtr createVirtual(VirtualClockPtr const & clock);
+    ~ScanExecutor();
+    ScanClockPtr getClock() const { return clock; }
+    epicsUInt64 now() { return clock->now(); }
+    /**
+     * Execute task once at or after deadline.
+     * @param deadline A time from the clock of the executor.
+     */
+    void schedule(Task::shared_pointer const & task,epicsUInt64 deadline);
+    /**
+     * Execute task as soon as a dispatch thread is free.
+     * A virtual executor runs it in order with its other tasks.
+     */
+    void submit(Task::shared_pointer const & task);
+    /**
+     * Run the next task of a virtual executor,
+     * moving the clock to its deadline.
+     * @return false if no task is ready or scheduled.
+     * @throws std::logic_error if the executor is not virtual.
+     */
+    bool runNext();
+    /**
+     * Run the tasks of a virtual executor that are due up to time,
+     * including tasks they schedule, and then set the clock to time.
+     * @return The number of tasks run.
+     */
+    size_t runUntil(epicsUInt64 time);
+    size_t getWorkers() const { return workers.size(); }
+    size_t getDispatchers() const { return dispatchers.size(); }
+    double getTick() const { return tickNs*1e-9; }
+    const static size_t wheelSize = 512;
+private:
+    class Timer;
+    class Worker;
+    friend class Timer;
+    friend class Worker;
+    struct Entry
+    {
+        Entry(Task::shared_pointer const & task,epicsUInt64 tick)
+        : task(task), tick(tick) {}
+        Task::shared_pointer task;
+        epicsUInt64 tick;
+    };
+    ScanExecutor(size_t workers,size_t dispatchers,double tick,ScanClockPtr const & clock);
+    epicsUInt64 nextTick();
+    void runTimer();
+    void runWorker(bool dispatch);
+
+    ScanClockPtr clock;
+    VirtualClockPtr virtualClock;
+    epicsUInt64 tickNs;
+    epicsUInt64 currentTick;
+    epicsUInt64 wakeTick;
+    size_t scheduled;
+    std::vector<Entry> wheel[wheelSize];
+    std::deque<Task::shared_pointer> ready;
+    std::deque<Task::shared_pointer> submitted;
+    bool stopping;
+    epics::pvData::Mutex mutex;
+    epicsEvent timerWakeup;
+    epicsEvent workAvailable;
+    epicsEvent dispatchAvailable;
+    std::tr1::shared_ptr<Timer> timer;
+    std::vector<std::tr1::shared_ptr<Worker> > workers;
+    std::vector<std::tr1::shared_ptr<Worker> > dispatchers;
+};
+
+}}
+
+#endif //SCANEXECUTOR_H
@@ -0,0 +1,68 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANHISTORY_H
+#define SCANHISTORY_H
+
+#include <vector>
+#include <pv/pvDatabase.h>
+#include <pv/readbackHistory.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanHistory;
+typedef std::tr1::shared_ptr<ScanHistory> ScanHistoryPtr;
+
+/**
+ * The history substructure of a record.
+ * It has long sequence, the sequence number of the first block it holds,
+ * long blocks, the number of blocks it holds,
+ * and double arrays x, y and time with the samples of those blocks.
+ * A client has missed blocks when sequence is not the sequence
+ * plus blocks of the update before.
+ */
+class epicsShareClass ScanHistory
+{
+public:
+    POINTER_DEFINITIONS(ScanHistory);
+    /**
+     * The introspection interface, created once.
+     */
+    static epics::pvData::StructureConstPtr getStructure();
+    /**
+     * @param pvHistory A field with the structure above.
+     */
+    static ScanHistoryPtr create(
+        epics::pvData::PVStructurePtr const & pvHistory,
+        ReadbackHistoryPtr const & history);
+    /**
+     * Copy the blocks completed since the last put into pvHistory.
+     * The caller must hold the lock of the record.
+     * @return false if there was no new block and nothing was changed.
+     */
+    bool put();
+private:
+    ScanHistory(
+        epics::pvData::PVStructurePtr const & pvHistory,
+        ReadbackHistoryPtr const & history);
+
+    ReadbackHistoryPtr history;
+    epics::pvData::PVLongPtr pvSequence;
+    epics::pvData::PVLongPtr pvBlocks;
+    epics::pvData::PVDoubleArrayPtr pvx;
+    epics::pvData::PVDoubleArrayPtr pvy;
+    epics::pvData::PVDoubleArrayPtr pvTime;
+    epicsUInt64 next;
+    std::vector<HistoryBlock> blocks;
+};
+
+}}
+
+#endif //SCANHISTORY_H
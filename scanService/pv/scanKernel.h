@@ -0,0 +1,102 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANKERNEL_H
+#define SCANKERNEL_H
+
+#include <cmath>
+#include <iostream>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * A position with D axes.
+ */
+template<size_t D>
+class PointN
+{
+public:
+    PointN()
+    {
+        for (size_t i=0; i<D; ++i) v[i] = 0.0;
+    }
+    double & operator[](size_t i) { return v[i]; }
+    double operator[](size_t i) const { return v[i]; }
+    const static size_t dimension = D;
+    double v[D];
+};
+
+template<size_t D>
+inline bool operator==(const PointN<D> & lhs, const PointN<D> &rhs)
+{
+    for (size_t i=0; i<D; ++i) if (lhs.v[i] != rhs.v[i]) return false;
+    return true;
+}
+
+template<size_t D>
+inline bool operator!=(const PointN<D> & lhs, const PointN<D> &rhs)
+{
+    return !(lhs == rhs);
+}
+
+template<size_t D>
+inline std::ostream & operator<< (std::ostream& os, const PointN<D>& point)
+{
+   os << "(";
+   for (size_t i=0; i<D; ++i) os << (i==0 ? "" : ",") << point.v[i];
+   os << ")";
+   return os;
+}
+
+/**
+ * Move readback one step toward setpoint.
+ * An axis within stepDistance (plus 1%) of the setpoint does not move.
+ * The axis with the largest remaining distance moves by stepDistance and
+ * the other axes move in proportion, so the readback moves in a straight line.
+ * When no axis can move the readback is set to the setpoint.
+ *
+ * The loops have no data dependent branches and a fixed trip count
+ * so that the compiler can vectorize them.
+ * @return true if readback has reached setpoint.
+ */
+template<size_t D>
+inline bool stepToward(
+    const PointN<D> & setpoint,
+    PointN<D> & readback,
+    double stepDistance)
+{
+    double delta[D];
+    double distance[D];
+    double threshold = stepDistance + stepDistance*.01;
+    double largest = 0.0;
+    for (size_t i=0; i<D; ++i)
+    {
+        double d = setpoint.v[i] - readback.v[i];
+        double a = std::fabs(d);
+        a = (a > threshold) ? a : 0.0;
+        delta[i] = d;
+        distance[i] = a;
+        largest = (a > largest) ? a : largest;
+    }
+    if (largest == 0.0)
+    {
+        readback = setpoint;
+        return true;
+    }
+    for (size_t i=0; i<D; ++i)
+    {
+        double move = stepDistance*(distance[i]/largest);
+        readback.v[i] += (delta[i] < 0.0) ? -move : move;
+    }
+    return false;
+}
+
+}}
+
+#endif //SCANKERNEL_H
@@ -0,0 +1,104 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANLOG_H
+#define SCANLOG_H
+
+#include <string>
+#include <vector>
+#include <pv/pvDatabase.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanLog;
+typedef std::tr1::shared_ptr<ScanLog> ScanLogPtr;
+
+/**
+ * A logger that never blocks the thread that logs.
+ * Each thread that logs gets its own queue, written only by that thread
+ * and read only by a background writer thread, so log takes no lock.
+ * The writer is woken only when a queue goes from empty to not empty,
+ * and otherwise drains every pollPeriod seconds.
+ * When a queue is full the message is dropped and counted.
+ * The writer merges the queues in the order the messages were logged
+ * and writes them to stdout, each after the name of its level.
+ * Environment variable SCAN_LOG_LEVEL sets the level of the shared logger
+ * to error, warn, info or debug (default info).
+ * When a thread exits its queue is drained once more and then freed.
+ */
+class epicsShareClass ScanLog
+{
+public:
+    POINTER_DEFINITIONS(ScanLog);
+    enum Level {
+        LOG_ERROR = 0,
+        LOG_WARN,
+        LOG_INFO,
+        LOG_DEBUG
+    };
+    const static size_t queueSize = 128;
+    const static size_t maxMessage = 240;
+    const static double pollPeriod;
+    static ScanLogPtr getShared();
+    static ScanLogPtr create(Level level);
+    ~ScanLog();
+    bool isEnabled(Level level);
+    void setLevel(Level level);
+    /**
+     * Queue a message; it is truncated to maxMessage characters.
+     */
+    void log(Level level,std::string const & message);
+    /**
+     * Write all queued messages before returning.
+     */
+    void flush();
+    size_t getDropped();
+private:
+    class Writer;
+    struct Message
+    {
+        size_t sequence;
+        int level;
+        char text[maxMessage + 1];
+    };
+    // who frees a queue: the logger once its thread has exited,
+    // or the thread itself if the logger was destroyed first
+    enum QueueState { QUEUE_LIVE = 0, QUEUE_EXITED, QUEUE_ORPHANED };
+    struct Queue
+    {
+        Queue() : head(0), tail(0), state(QUEUE_LIVE) {}
+        Message messages[queueSize];
+        size_t head;
+        size_t tail;
+        int state;
+    };
+    ScanLog(Level level);
+    static void threadExit(void * arg);
+    Queue * getQueue();
+    void run();
+    void drain();
+
+    int level;
+    size_t sequence;
+    size_t dropped;
+    bool stopping;
+    epicsThreadPrivateId queueKey;
+    std::vector<Queue *> queues;
+    epics::pvData::Mutex mutex;
+    epics::pvData::Mutex drainMutex;
+    epicsEvent wakeup;
+    std::tr1::shared_ptr<Writer> writer;
+};
+
+}}
+
+#endif //SCANLOG_H
@@ -0,0 +1,101 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANMETRICS_H
+#define SCANMETRICS_H
+
+#include <pv/pvDatabase.h>
+#include <epicsTime.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanMetrics;
+typedef std::tr1::shared_ptr<ScanMetrics> ScanMetricsPtr;
+
+/**
+ * A histogram of durations in nanoseconds with HDR style buckets.
+ * Every power of two is split into subBuckets linear buckets, so a
+ * recorded value is kept with a relative error below 1/subBuckets
+ * over the whole range of epicsUInt64.
+ * record only increments counters with atomic operations, so it can
+ * be called from any thread without a lock.
+ */
+class epicsShareClass LatencyHistogram
+{
+public:
+    const static size_t subBuckets = 16;
+    const static size_t buckets = 61*subBuckets;
+    LatencyHistogram();
+    void record(epicsUInt64 ns);
+    void reset();
+    size_t getCount() const;
+    /**
+     * The statistics are in seconds.
+     * Each value is the highest value of the bucket that holds it.
+     */
+    double getMean() const;
+    double getMax() const;
+    /**
+     * @param percentile In percent, for example 99.9.
+     */
+    double getPercentile(double percentile) const;
+private:
+    static size_t bucketIndex(epicsUInt64 value);
+    static epicsUInt64 bucketLowest(size_t index);
+    static epicsUInt64 bucketHighest(size_t index);
+    size_t counts[buckets];
+    size_t maxIndex;
+};
+
+/**
+ * Records the time from construction to destruction in a histogram.
+ */
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyHistogram & histogram)
+    : histogram(histogram),
+      start(epicsMonotonicGet())
+    {}
+    ~LatencyTimer() { histogram.record(epicsMonotonicGet() - start); }
+private:
+    LatencyHistogram & histogram;
+    epicsUInt64 start;
+};
+
+/**
+ * The latency histograms of one scan service and the record that serves it.
+ * stepLatency is the time from the deadline of a step until it is done.
+ * callbackDuration is the time each callback takes.
+ * lockWait is the time a record waits for its lock to publish an update.
+ * serviceTime is the time a record takes to serve a client request.
+ */
+class epicsShareClass ScanMetrics
+{
+public:
+    POINTER_DEFINITIONS(ScanMetrics);
+    static ScanMetricsPtr create();
+    LatencyHistogram & getStepLatency() { return stepLatency; }
+    LatencyHistogram & getCallbackDuration() { return callbackDuration; }
+    LatencyHistogram & getLockWait() { return lockWait; }
+    LatencyHistogram & getServiceTime() { return serviceTime; }
+    void reset();
+private:
+    ScanMetrics() {}
+    LatencyHistogram stepLatency;
+    LatencyHistogram callbackDuration;
+    LatencyHistogram lockWait;
+    LatencyHistogram serviceTime;
+};
+
+}}
+
+#endif //SCANMETRICS_H
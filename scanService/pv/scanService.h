@@ -14,7 +14,14 @@
 #include <iostream>
 #include <pv/pvDatabase.h>
 #include <epicsThread.h>
+#include <epicsTypes.h>
 #include <shareLib.h>
+#include <pv/callbackRegistry.h>
+#include <pv/scanExecutor.h>
+#include <pv/scanMetrics.h>
+#include <pv/scanTrace.h>
+#include <pv/scanLog.h>
+#include <pv/readbackHistory.h>
 
 namespace epics { namespace exampleScan {
 
@@ -58,10 +65,170 @@ inline std::ostream & operator<< (std::ostream& os, const Point& point)
    return os;
 }
 
+class ScanPlan;
+typedef std::tr1::shared_ptr<ScanPlan> ScanPlanPtr;
+
+/**
+ * The points of a scan.
+ * A plan is immutable once created so it can be shared without copying.
+ */
+class epicsShareClass ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(ScanPlan);
+    virtual ~ScanPlan() {}
+    virtual size_t size() const = 0;
+    virtual Point getPoint(size_t index) const = 0;
+};
+
+/**
+ * A plan that holds its points as x and y columns.
+ * The columns are shared, not copied, so a plan can be made directly from
+ * the arrays of a PVStructure.
+ */
+class epicsShareClass PointListPlan : public ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(PointListPlan);
+    /**
+     * @throws std::runtime_error if x and y do not have the same length.
+     */
+    static PointListPlan::shared_pointer create(
+        epics::pvData::shared_vector<const double> const & x,
+        epics::pvData::shared_vector<const double> const & y);
+    static PointListPlan::shared_pointer create(const std::vector<Point> & points);
+    virtual size_t size() const { return x.size(); }
+    virtual Point getPoint(size_t index) const { return Point(x[index],y[index]); }
+    epics::pvData::shared_vector<const double> getX() const { return x; }
+    epics::pvData::shared_vector<const double> getY() const { return y; }
+private:
+    PointListPlan(
+        epics::pvData::shared_vector<const double> const & x,
+        epics::pvData::shared_vector<const double> const & y)
+    : x(x), y(y)
+    {}
+    const epics::pvData::shared_vector<const double> x;
+    const epics::pvData::shared_vector<const double> y;
+};
+
+/**
+ * A consistent view of the scan state.
+ * It is published by the scan service whenever the state changes and
+ * can be read without waiting for the scan thread.
+ */
+class ScanSnapshot
+{
+public:
+    ScanSnapshot()
+    : index(0),
+      total(0),
+      active(false),
+      stepDelay(0.0),
+      stepDistance(0.0)
+    {}
+    Point setpoint;
+    Point readback;
+    size_t index;
+    size_t total;
+    bool active;
+    double stepDelay;
+    double stepDistance;
+};
+
+/**
+ * Statistics of the stepping loop.
+ * Each step is scheduled against an absolute deadline on the monotonic clock.
+ * The achieved period and jitter are computed from the intervals between
+ * the starts of consecutive steps.
+ * A deadline is missed when its step starts a full period or more late.
+ * The start latency is the time from startScan to the first new setpoint.
+ * The hold times are how long a step holds the service mutex,
+ * measured on the monotonic clock even when the executor is virtual.
+ * A step starts on a tick of the executor timer wheel, tick seconds long,
+ * so it runs up to one tick after its deadline.
+ * The deadlines are absolute, so the mean period is kept, but each interval
+ * is a whole number of ticks and jitter includes up to one tick.
+ */
+class StepStats
+{
+public:
+    StepStats()
+    : steps(0),
+      missedDeadlines(0),
+      skippedDeadlines(0),
+      targetPeriod(0),
+      achievedPeriod(0),
+      jitter(0),
+      maxLateness(0),
+      startLatency(0),
+      meanHoldTime(0),
+      maxHoldTime(0),
+      tick(0)
+    {}
+    size_t steps;
+    size_t missedDeadlines;
+    size_t skippedDeadlines;
+    double targetPeriod;
+    double achievedPeriod;
+    double jitter;
+    double maxLateness;
+    double startLatency;
+    double meanHoldTime;
+    double maxHoldTime;
+    double tick;
+};
+
+inline std::ostream & operator<< (std::ostream& os, const StepStats& stats)
+{
+   os << "steps " << stats.steps
+      << " missedDeadlines " << stats.missedDeadlines
+      << " skippedDeadlines " << stats.skippedDeadlines
+      << " targetPeriod " << stats.targetPeriod
+      << " achievedPeriod " << stats.achievedPeriod
+      << " jitter " << stats.jitter
+      << " maxLateness " << stats.maxLateness
+      << " startLatency " << stats.startLatency
+      << " meanHoldTime " << stats.meanHoldTime
+      << " maxHoldTime " << stats.maxHoldTime
+      << " tick " << stats.tick;
+   return os;
+}
+
+/**
+ * Counters of the callback dispatcher.
+ * Notifications posted while the dispatcher is busy are merged into
+ * the last queued notification unless it reports a scan completion.
+ * When the queue is full a notification is merged anyway and counted
+ * as dropped since its completion boundary is lost.
+ */
+class DispatchStats
+{
+public:
+    DispatchStats()
+    : posted(0),
+      delivered(0),
+      merged(0),
+      dropped(0)
+    {}
+    size_t posted;
+    size_t delivered;
+    size_t merged;
+    size_t dropped;
+};
+
+inline std::ostream & operator<< (std::ostream& os, const DispatchStats& stats)
+{
+   os << "posted " << stats.posted
+      << " delivered " << stats.delivered
+      << " merged " << stats.merged
+      << " dropped " << stats.dropped;
+   return os;
+}
+
 class ScanService;
 typedef std::tr1::shared_ptr<ScanService> ScanServicePtr;
 
-class epicsShareClass ScanService : public epicsThreadRunable,
+class epicsShareClass ScanService :
     public std::tr1::enable_shared_from_this<ScanService>
 {
 public:
@@ -73,27 +240,141 @@ public:
         const static int SETPOINT_CHANGED  = 0x1;
         const static int READBACK_CHANGED  = 0x2;
         const static int SCAN_COMPLETE     = 0x4;
+        const static int HISTORY_CHANGED   = 0x8;
     };
 public:
+    /**
+     * Create a service that steps on the shared executor.
+     */
     static ScanServicePtr create();
+    static ScanServicePtr create(ScanExecutorPtr const & executor);
     POINTER_DEFINITIONS(ScanService);
-    virtual bool init() { return false;}
-    virtual void run();
     void registerCallback(Callback::shared_pointer const & callback);
     bool unregisterCallback(Callback::shared_pointer const & callback);
     Point getPositionSetpoint();
     Point getPositionReadback();
+    /**
+     * Get the latest published state.
+     * This never blocks the scan thread and never takes the service mutex.
+     */
+    ScanSnapshot getSnapshot();
     void configure(const std::vector<Point> & newPoints);
+    /**
+     * Replace the plan.
+     * Only the plan pointer is exchanged while the mutex is held.
+     */
+    void configure(ScanPlanPtr const & newPlan);
+    /**
+     * Start the scan. No step runs while a service is idle,
+     * so the first step is scheduled immediately.
+     */
     void startScan();
     void stopScan();
     void setRate(double stepDelay,double stepDistance);
     void setDebug(bool value);
+    /**
+     * An ordered list of commands for execute.
+     */
+    class epicsShareClass Batch
+    {
+    public:
+        void configure(ScanPlanPtr const & plan);
+        void startScan();
+        void stopScan();
+        void setRate(double stepDelay,double stepDistance);
+        void setDebug(bool value);
+        size_t size() const { return commands.size(); }
+    private:
+        friend class ScanService;
+        enum Type { CONFIGURE, START_SCAN, STOP_SCAN, SET_RATE, SET_DEBUG };
+        struct Command
+        {
+            Command(Type type) : type(type), stepDelay(0.0), stepDistance(0.0), value(false) {}
+            Type type;
+            ScanPlanPtr plan;
+            double stepDelay;
+            double stepDistance;
+            bool value;
+        };
+        std::vector<Command> commands;
+    };
+    /**
+     * Run the commands of a batch in order while holding the mutex,
+     * so no other command and no step runs between them.
+     * It stops at the first command that fails; the commands before it
+     * stay applied.
+     * @param error gets the message of the command that failed.
+     * @return the number of commands that succeeded.
+     */
+    size_t execute(Batch const & batch,std::string & error);
+    /**
+     * Get the statistics of the stepping loop since the last reset.
+     * The statistics are reset by startScan.
+     */
+    StepStats getStepStats();
+    void resetStepStats();
+    DispatchStats getDispatchStats();
+    /**
+     * Set a callback that sees the flags of every update as it is posted,
+     * before the dispatcher merges it with others.
+     * It is called by the thread that steps, holding the service mutex,
+     * so it must not block or call the service except for getSnapshot.
+     * It is meant for simulation and tests. An empty pointer removes it.
+     */
+    void setPostObserver(Callback::shared_pointer const & observer);
+    /**
+     * Get the latency histograms.
+     * The service records step latency and callback duration,
+     * the record that serves it records lock wait and service time.
+     */
+    ScanMetricsPtr getMetrics() { return metrics; }
+    ScanExecutorPtr getExecutor() { return executor; }
+    /**
+     * Get the readback history. Every readback of a step is a sample.
+     * A block is completed when it is full and when a scan stops,
+     * and each completed block is reported with HISTORY_CHANGED.
+     */
+    ReadbackHistoryPtr getHistory() { return history; }
+    /**
+     * Record an event in the shared trace with the source id of this service.
+     */
+    void trace(ScanTrace::EventType type,double a = 0.0,double b = 0.0)
+    {
+        traceBuffer->record(type,traceSource,a,b);
+    }
+    /**
+     * A late step loop runs back to back steps until it is on schedule again.
+     * If it is more than maxCatchUpSteps periods late the remaining deadlines
+     * are skipped and the schedule restarts from the current time.
+     */
+    const static size_t maxCatchUpSteps = 10;
+    /**
+     * Callbacks are called by a dispatcher task, never by a step.
+     * This is the maximum number of notifications it queues.
+     */
+    const static size_t dispatchQueueSize = 16;
+    /**
+     * The number of samples in a block of the readback history
+     * and the number of completed blocks it keeps.
+     */
+    const static size_t historyBlockSize = 256;
+    const static size_t historyBlockCount = 16;
 private:
-    ScanService();
-    void startThread() { thread->start(); }
+    class StepTask;
+    class Dispatcher;
+    friend class StepTask;
+    friend class Dispatcher;
+    ScanService(ScanExecutorPtr const & executor);
+    void executeStep();
+    void step();
+    void recordStepStart(epicsUInt64 deadline,epicsUInt64 now);
+    void scheduleStep();
     void setSetpoint(Point sp);
     void setReadback(Point rb);
     void update();
+    void deliver(int flags);
+    void publishSnapshot();
+    void setWallOffset();
     bool scanningActive;
     size_t index;
     int flags;
@@ -101,12 +382,40 @@ private:
     double stepDistance;
     bool debug;
 
+    epicsUInt64 periodNs;
+    epicsUInt64 deadline;
+    epicsUInt64 lastStepStart;
+    double intervalSum;
+    double intervalSumSquares;
+    size_t intervals;
+    double holdSum;
+    StepStats stepStats;
+    // true while stepTask is scheduled or executing
+    bool stepScheduled;
+    // true from startScan until the scan produces its first setpoint
+    bool awaitingSetpoint;
+    epicsUInt64 scanStart;
+
+    // seqlock: odd while the snapshot is being written
+    size_t snapshotSequence;
+    ScanSnapshot snapshot;
+
     Point positionSP;
     Point positionRB;
-    std::vector<Callback::shared_pointer> callbacks;
-    std::vector<Point> points;
+    CallbackRegistry<Callback::shared_pointer> callbacks;
+    Callback::shared_pointer postObserver;
+    ScanPlanPtr plan;
     epics::pvData::Mutex mutex;
-    EpicsThreadPtr thread;
+    ScanExecutorPtr executor;
+    ScanMetricsPtr metrics;
+    ScanTracePtr traceBuffer;
+    epicsUInt32 traceSource;
+    ScanLogPtr logger;
+    ReadbackHistoryPtr history;
+    // seconds past the POSIX epoch at time 0 of the executor clock
+    double wallOffset;
+    std::tr1::shared_ptr<StepTask> stepTask;
+    std::tr1::shared_ptr<Dispatcher> dispatcher;
 };
 
 
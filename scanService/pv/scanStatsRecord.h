@@ -0,0 +1,81 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANSTATSRECORD_H
+#define SCANSTATSRECORD_H
+
+#include <pv/pvDatabase.h>
+#include <pv/scanService.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanStatsRecord;
+typedef std::tr1::shared_ptr<ScanStatsRecord> ScanStatsRecordPtr;
+
+/**
+ * A record that publishes the latency histograms of a scan service.
+ * It is named <recordName>:stats after the record that serves the scan.
+ * Each histogram is a structure with fields
+ * count, mean, p50, p90, p99, p999 and max, in seconds.
+ * Field stepStats holds the StepStats of the service, times in seconds.
+ * The record is refreshed every refreshPeriod seconds by the executor
+ * of the scan service. Putting true to field reset clears the histograms
+ * and the step statistics.
+ */
+class epicsShareClass ScanStatsRecord :
+    public epics::pvDatabase::PVRecord
+{
+public:
+    POINTER_DEFINITIONS(ScanStatsRecord);
+    static ScanStatsRecordPtr create(
+        std::string const & recordName,
+        ScanServicePtr const & scanService);
+    virtual ~ScanStatsRecord() {}
+    virtual bool init() {return false;}
+    virtual void process();
+    void refresh();
+    const static double refreshPeriod;
+private:
+    class RefreshTask;
+    struct HistogramFields
+    {
+        epics::pvData::PVLongPtr count;
+        epics::pvData::PVDoublePtr mean;
+        epics::pvData::PVDoublePtr p50;
+        epics::pvData::PVDoublePtr p90;
+        epics::pvData::PVDoublePtr p99;
+        epics::pvData::PVDoublePtr p999;
+        epics::pvData::PVDoublePtr max;
+    };
+    ScanStatsRecord(std::string const & recordName,
+        epics::pvData::PVStructurePtr const & pvStructure,
+        ScanServicePtr const & scanService);
+    void initPvt();
+    void attach(HistogramFields & fields,const char * name);
+    void put(HistogramFields & fields,LatencyHistogram const & histogram);
+    void putStepStats();
+
+    epics::pvData::PVBooleanPtr pvReset;
+    HistogramFields stepLatency;
+    HistogramFields callbackDuration;
+    HistogramFields lockWait;
+    HistogramFields serviceTime;
+    epics::pvData::PVStructurePtr pvStepStats;
+
+    ScanServicePtr scanService;
+    ScanMetricsPtr metrics;
+    ScanExecutorPtr executor;
+    std::tr1::shared_ptr<RefreshTask> refreshTask;
+};
+
+}}
+
+#endif  /* SCANSTATSRECORD_H */
@@ -0,0 +1,43 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANSTATUS_H
+#define SCANSTATUS_H
+
+#include <pv/pvDatabase.h>
+#include <pv/scanService.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * The status returned by the status method and command.
+ * It has a fixed layout:
+ * positionSP and positionRB with double fields x and y,
+ * long index and total, string state (idle or active),
+ * and double stepDelay and stepDistance.
+ */
+class epicsShareClass ScanStatus
+{
+public:
+    /**
+     * The introspection interface, created once.
+     */
+    static epics::pvData::StructureConstPtr getStructure();
+    /**
+     * Copy a snapshot into pvStatus, which must have the structure above.
+     */
+    static void put(
+        epics::pvData::PVStructurePtr const & pvStatus,
+        ScanSnapshot const & snapshot);
+};
+
+}}
+
+#endif //SCANSTATUS_H
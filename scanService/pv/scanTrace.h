@@ -0,0 +1,130 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef SCANTRACE_H
+#define SCANTRACE_H
+
+#include <string>
+#include <pv/pvDatabase.h>
+#include <epicsTypes.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+class ScanTrace;
+typedef std::tr1::shared_ptr<ScanTrace> ScanTracePtr;
+
+/**
+ * One binary trace event.
+ * time is from epicsMonotonicGet in nanoseconds.
+ * source identifies the scan service that recorded the event.
+ * The meaning of a and b depends on type, see ScanTrace.
+ * sequence is written last; it is one more than the position of the
+ * event in the trace, so a reader can tell a complete event from one
+ * that is being overwritten.
+ */
+struct TraceEvent
+{
+    epicsUInt64 time;
+    epicsUInt32 type;
+    epicsUInt32 source;
+    double a;
+    double b;
+    size_t sequence;
+};
+
+/**
+ * A fixed size ring of binary trace events shared by all scan services
+ * of the process.
+ * record is lock free: a writer claims a slot with an atomic increment,
+ * so the oldest events are overwritten once the ring is full.
+ *
+ * Event types and their values:
+ *   SETPOINT        a,b = x,y of the new setpoint
+ *   READBACK        a,b = x,y of the new readback
+ *   SCAN_START      a = number of points
+ *   SCAN_STOP       a = index reached
+ *   CONFIGURE       a = number of points
+ *   CALLBACK_ENTER  a = callback flags
+ *   CALLBACK_EXIT   a = callback flags
+ *   REQUEST         a = request code, see RequestCode
+ *
+ * dump writes the events, oldest first, to a file. The file starts with
+ * the 8 characters "SCANTRC1", then the event count and the size of an
+ * event as epicsUInt32, followed by the events in host byte order.
+ */
+class epicsShareClass ScanTrace
+{
+public:
+    POINTER_DEFINITIONS(ScanTrace);
+    enum EventType {
+        SETPOINT = 1,
+        READBACK,
+        SCAN_START,
+        SCAN_STOP,
+        CONFIGURE,
+        CALLBACK_ENTER,
+        CALLBACK_EXIT,
+        REQUEST
+    };
+    enum RequestCode {
+        REQUEST_CONFIGURE = 1,
+        REQUEST_CONFIGURE_TRAJECTORY,
+        REQUEST_START,
+        REQUEST_STOP,
+        REQUEST_SET_RATE,
+        REQUEST_SET_DEBUG,
+        REQUEST_SCAN,
+        REQUEST_DUMP_TRACE,
+        REQUEST_BATCH,
+        REQUEST_STATUS,
+        REQUEST_SET_PUBLISH_RATE
+    };
+    const static size_t capacity = 65536;
+    static ScanTracePtr getShared();
+    static ScanTracePtr create();
+    ~ScanTrace();
+    /**
+     * Get a new source id for a scan service.
+     */
+    epicsUInt32 createSource();
+    void record(EventType type,epicsUInt32 source,double a = 0.0,double b = 0.0);
+    void setEnabled(bool value);
+    bool isEnabled();
+    /**
+     * Write the trace to a file.
+     * @return The number of events written.
+     * @throws std::runtime_error if the file cannot be written.
+     */
+    size_t dump(std::string const & fileName);
+    /**
+     * Write the trace to a file in the dump directory.
+     * This is what remote requests use, so they cannot write elsewhere.
+     * The shared trace takes the directory from environment variable
+     * SCAN_TRACE_DIR; without it remote dumps are disabled.
+     * @throws std::runtime_error if there is no dump directory,
+     * if name is empty or has a /, \ or .., or if the file cannot be written.
+     */
+    size_t dumpNamed(std::string const & name);
+    /**
+     * Set the directory for dumpNamed. Call this at startup.
+     */
+    void setDumpDirectory(std::string const & directory);
+private:
+    ScanTrace();
+    TraceEvent * events;
+    size_t next;
+    size_t sources;
+    int enabled;
+    std::string dumpDirectory;
+};
+
+}}
+
+#endif //SCANTRACE_H
@@ -0,0 +1,156 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <pv/pvDatabase.h>
+#include <pv/scanService.h>
+#include <shareLib.h>
+
+namespace epics { namespace exampleScan {
+
+/**
+ * Plans that compute each point from a few parameters.
+ * They use constant memory and are created in constant time.
+ */
+
+/**
+ * nx by ny points evenly spaced from start to stop, row by row.
+ * A serpentine raster reverses the direction of every other row.
+ */
+class epicsShareClass RasterPlan : public ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(RasterPlan);
+    static RasterPlan::shared_pointer create(
+        double xStart, double xStop, size_t nx,
+        double yStart, double yStop, size_t ny,
+        bool serpentine);
+    virtual size_t size() const { return nx*ny; }
+    virtual Point getPoint(size_t index) const;
+private:
+    RasterPlan(
+        double xStart, double xStop, size_t nx,
+        double yStart, double yStop, size_t ny,
+        bool serpentine);
+    double xStart;
+    double xStep;
+    size_t nx;
+    double yStart;
+    double yStep;
+    size_t ny;
+    bool serpentine;
+};
+
+/**
+ * nx by ny points starting at (xStart,yStart) with a fixed step, row by row.
+ */
+class epicsShareClass GridPlan : public ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(GridPlan);
+    static GridPlan::shared_pointer create(
+        double xStart, double xStep, size_t nx,
+        double yStart, double yStep, size_t ny);
+    virtual size_t size() const { return nx*ny; }
+    virtual Point getPoint(size_t index) const;
+private:
+    GridPlan(
+        double xStart, double xStep, size_t nx,
+        double yStart, double yStep, size_t ny)
+    : xStart(xStart), xStep(xStep), nx(nx),
+      yStart(yStart), yStep(yStep), ny(ny)
+    {}
+    double xStart;
+    double xStep;
+    size_t nx;
+    double yStart;
+    double yStep;
+    size_t ny;
+};
+
+/**
+ * An Archimedean spiral around (xCenter,yCenter).
+ * The radius grows by pitch every turn and each turn has pointsPerTurn points.
+ */
+class epicsShareClass SpiralPlan : public ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(SpiralPlan);
+    static SpiralPlan::shared_pointer create(
+        double xCenter, double yCenter,
+        double pitch, size_t pointsPerTurn, size_t npoints);
+    virtual size_t size() const { return npoints; }
+    virtual Point getPoint(size_t index) const;
+private:
+    SpiralPlan(
+        double xCenter, double yCenter,
+        double pitch, size_t pointsPerTurn, size_t npoints)
+    : xCenter(xCenter), yCenter(yCenter),
+      pitch(pitch), pointsPerTurn(pointsPerTurn), npoints(npoints)
+    {}
+    double xCenter;
+    double yCenter;
+    double pitch;
+    size_t pointsPerTurn;
+    size_t npoints;
+};
+
+/**
+ * npoints of one period of
+ * x = xCenter + xAmplitude*sin(xFrequency*t + phase),
+ * y = yCenter + yAmplitude*sin(yFrequency*t).
+ */
+class epicsShareClass LissajousPlan : public ScanPlan
+{
+public:
+    POINTER_DEFINITIONS(LissajousPlan);
+    static LissajousPlan::shared_pointer create(
+        double xCenter, double yCenter,
+        double xAmplitude, double yAmplitude,
+        double xFrequency, double yFrequency,
+        double phase, size_t npoints);
+    virtual size_t size() const { return npoints; }
+    virtual Point getPoint(size_t index) const;
+private:
+    LissajousPlan(
+        double xCenter, double yCenter,
+        double xAmplitude, double yAmplitude,
+        double xFrequency, double yFrequency,
+        double phase, size_t npoints)
+    : xCenter(xCenter), yCenter(yCenter),
+      xAmplitude(xAmplitude), yAmplitude(yAmplitude),
+      xFrequency(xFrequency), yFrequency(yFrequency),
+      phase(phase), npoints(npoints)
+    {}
+    double xCenter;
+    double yCenter;
+    double xAmplitude;
+    double yAmplitude;
+    double xFrequency;
+    double yFrequency;
+    double phase;
+    size_t npoints;
+};
+
+/**
+ * Create a plan from a trajectory argument structure.
+ * Field type selects raster, serpentine, grid, spiral or lissajous.
+ * The other fields are the parameters of the create methods above,
+ * with nx, ny, pointsPerTurn and npoints as integer fields.
+ * Only the fields used by the selected type need to be present.
+ * @throws std::runtime_error if a field is missing or a value is illegal.
+ */
+epicsShareFunc ScanPlanPtr createTrajectory(
+    epics::pvData::PVStructurePtr const & args);
+
+}}
+
+#endif //TRAJECTORY_H
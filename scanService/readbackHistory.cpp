@@ -0,0 +1,92 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <stdexcept>
+#include <epicsExport.h>
+#include "pv/readbackHistory.h"
+
+using namespace epics::pvData;
+
+namespace epics { namespace exampleScan {
+
+ReadbackHistoryPtr ReadbackHistory::create(size_t blockSize,size_t blockCount)
+{
+    if (blockSize == 0 || blockCount == 0)
+    {
+        throw std::invalid_argument("ReadbackHistory needs a block size and count");
+    }
+    return ReadbackHistoryPtr(new ReadbackHistory(blockSize,blockCount));
+}
+
+ReadbackHistory::ReadbackHistory(size_t blockSize,size_t blockCount)
+: blockSize(blockSize),
+  filled(0),
+  ring(blockCount),
+  nextSequence(0)
+{
+    allocate();
+}
+
+void ReadbackHistory::allocate()
+{
+    x = shared_vector<double>(blockSize);
+    y = shared_vector<double>(blockSize);
+    time = shared_vector<double>(blockSize);
+    filled = 0;
+}
+
+bool ReadbackHistory::add(double xValue,double yValue,double timeValue)
+{
+    x[filled] = xValue;
+    y[filled] = yValue;
+    time[filled] = timeValue;
+    if (++filled < blockSize) return false;
+    complete();
+    return true;
+}
+
+bool ReadbackHistory::flush()
+{
+    if (filled == 0) return false;
+    x.resize(filled);
+    y.resize(filled);
+    time.resize(filled);
+    complete();
+    return true;
+}
+
+// freezing hands the arrays to the ring, the next block gets new ones
+void ReadbackHistory::complete()
+{
+    HistoryBlock block;
+    block.x = freeze(x);
+    block.y = freeze(y);
+    block.time = freeze(time);
+    {
+        Lock lock(mutex);
+        block.sequence = nextSequence;
+        ring[nextSequence % ring.size()] = block;
+        ++nextSequence;
+    }
+    allocate();
+}
+
+epicsUInt64 ReadbackHistory::getBlocks(epicsUInt64 since,std::vector<HistoryBlock> & blocks)
+{
+    Lock lock(mutex);
+    epicsUInt64 oldest = (nextSequence > ring.size()) ? nextSequence - ring.size() : 0;
+    if (since < oldest) since = oldest;
+    for (epicsUInt64 sequence = since; sequence < nextSequence; ++sequence)
+    {
+        blocks.push_back(ring[sequence % ring.size()]);
+    }
+    return nextSequence;
+}
+
+}}
@@ -0,0 +1,374 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <cstdlib>
+#include <stdexcept>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsExport.h>
+#include "pv/scanExecutor.h"
+#include "pv/scanLog.h"
+
+using namespace std;
+
+namespace epics { namespace exampleScan {
+
+typedef std::tr1::shared_ptr<epicsThread> EpicsThreadPtr;
+
+class ScanExecutor::Timer : public epicsThreadRunable
+{
+public:
+    Timer(ScanExecutor & executor)
+    : executor(executor),
+      thread(new epicsThread(
+        *this,
+        "scanExecutorTimer",
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        epicsThreadPriorityMedium))
+    {}
+    virtual void run() { executor.runTimer(); }
+    ScanExecutor & executor;
+    EpicsThreadPtr thread;
+};
+
+class ScanExecutor::Worker : public epicsThreadRunable
+{
+public:
+    Worker(ScanExecutor & executor,bool dispatch)
+    : executor(executor),
+      dispatch(dispatch),
+      thread(new epicsThread(
+        *this,
+        dispatch ? "scanExecutorDispatch" : "scanExecutorWorker",
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        epicsThreadPriorityLow))
+    {}
+    virtual void run() { executor.runWorker(dispatch); }
+    ScanExecutor & executor;
+    bool dispatch;
+    EpicsThreadPtr thread;
+};
+
+class MonotonicClock : public ScanClock
+{
+public:
+    virtual epicsUInt64 now() { return epicsMonotonicGet(); }
+};
+
+static ScanClockPtr monotonicClock;
+static epicsThreadOnceId monotonicOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createMonotonic(void *)
+{
+    monotonicClock = ScanClockPtr(new MonotonicClock());
+}
+
+ScanClockPtr ScanClock::getMonotonic()
+{
+    epicsThreadOnce(&monotonicOnce,createMonotonic,0);
+    return monotonicClock;
+}
+
+static ScanExecutorPtr sharedExecutor;
+static epicsThreadOnceId sharedOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createShared(void *)
+{
+    size_t workers = 2;
+    size_t dispatchers = 1;
+    double tick = .0001;
+    const char * value = getenv("SCAN_EXECUTOR_WORKERS");
+    if (value && atoi(value) > 0) workers = atoi(value);
+    value = getenv("SCAN_EXECUTOR_DISPATCHERS");
+    if (value && atoi(value) > 0) dispatchers = atoi(value);
+    value = getenv("SCAN_EXECUTOR_TICK");
+    if (value && atof(value) > 0.0) tick = atof(value);
+    sharedExecutor = ScanExecutor::create(workers,tick,dispatchers);
+}
+
+ScanExecutorPtr ScanExecutor::getShared()
+{
+    epicsThreadOnce(&sharedOnce,createShared,0);
+    return sharedExecutor;
+}
+
+ScanExecutorPtr ScanExecutor::create(size_t workers,double tick,size_t dispatchers)
+{
+    if (workers == 0) workers = 1;
+    if (dispatchers == 0) dispatchers = 1;
+    ScanExecutorPtr executor(new ScanExecutor(workers,dispatchers,tick,ScanClock::getMonotonic()));
+    executor->timer->thread->start();
+    for (size_t i=0; i<executor->workers.size(); ++i)
+    {
+        executor->workers[i]->thread->start();
+    }
+    for (size_t i=0; i<executor->dispatchers.size(); ++i)
+    {
+        executor->dispatchers[i]->thread->start();
+    }
+    return executor;
+}
+
+ScanExecutorPtr ScanExecutor::createVirtual(VirtualClockPtr const & clock)
+{
+    // a tick of 1ns so that tasks run exactly at their deadline
+    ScanExecutorPtr executor(new ScanExecutor(0,0,1e-9,clock));
+    executor->virtualClock = clock;
+    return executor;
+}
+
+ScanExecutor::ScanExecutor(size_t workers,size_t dispatchers,double tick,ScanClockPtr const & clock)
+: clock(clock),
+  tickNs(static_cast<epicsUInt64>(tick*1e9)),
+  currentTick(0),
+  wakeTick(~epicsUInt64(0)),
+  scheduled(0),
+  stopping(false)
+{
+    if (tickNs == 0) tickNs = 1;
+    // a virtual executor has no threads
+    if (workers == 0) return;
+    timer = std::tr1::shared_ptr<Timer>(new Timer(*this));
+    for (size_t i=0; i<workers; ++i)
+    {
+        this->workers.push_back(std::tr1::shared_ptr<Worker>(new Worker(*this,false)));
+    }
+    for (size_t i=0; i<dispatchers; ++i)
+    {
+        this->dispatchers.push_back(std::tr1::shared_ptr<Worker>(new Worker(*this,true)));
+    }
+}
+
+ScanExecutor::~ScanExecutor()
+{
+    {
+        epics::pvData::Lock lock(mutex);
+        stopping = true;
+    }
+    if (!timer) return;
+    timerWakeup.trigger();
+    workAvailable.trigger();
+    dispatchAvailable.trigger();
+    timer->thread->exitWait();
+    for (size_t i=0; i<workers.size(); ++i) workers[i]->thread->exitWait();
+    for (size_t i=0; i<dispatchers.size(); ++i) dispatchers[i]->thread->exitWait();
+}
+
+void ScanExecutor::schedule(Task::shared_pointer const & task,epicsUInt64 deadline)
+{
+    // round up so that a task never runs before its deadline
+    epicsUInt64 tick = (deadline + tickNs - 1)/tickNs;
+    bool wakeTimer = false;
+    bool due = false;
+    {
+        epics::pvData::Lock lock(mutex);
+        if (scheduled == 0)
+        {
+            // the timer was idle, do not make it walk the ticks it slept through
+            currentTick = clock->now()/tickNs;
+        }
+        if (tick <= currentTick)
+        {
+            ready.push_back(task);
+            due = true;
+        }
+        else
+        {
+            wheel[tick%wheelSize].push_back(Entry(task,tick));
+            scheduled++;
+            if (tick < wakeTick)
+            {
+                wakeTick = tick;
+                wakeTimer = true;
+            }
+        }
+    }
+    if (wakeTimer) timerWakeup.trigger();
+    if (due) workAvailable.trigger();
+}
+
+void ScanExecutor::submit(Task::shared_pointer const & task)
+{
+    {
+        epics::pvData::Lock lock(mutex);
+        // a virtual executor keeps one queue so that the order of steps
+        // and callbacks is deterministic
+        if (virtualClock)
+        {
+            ready.push_back(task);
+            return;
+        }
+        submitted.push_back(task);
+    }
+    dispatchAvailable.trigger();
+}
+
+epicsUInt64 ScanExecutor::nextTick()
+{
+    // a virtual executor jumps over empty ticks, so search every slot
+    epicsUInt64 next = ~epicsUInt64(0);
+    for (size_t i=0; i<wheelSize; ++i)
+    {
+        std::vector<Entry> & slot = wheel[i];
+        for (size_t j=0; j<slot.size(); ++j)
+        {
+            if (slot[j].tick < next) next = slot[j].tick;
+        }
+    }
+    return next;
+}
+
+bool ScanExecutor::runNext()
+{
+    Task::shared_pointer task;
+    {
+        epics::pvData::Lock lock(mutex);
+        if (!virtualClock) throw std::logic_error("runNext requires a virtual executor");
+        if (ready.empty())
+        {
+            if (scheduled == 0) return false;
+            currentTick = nextTick();
+            std::vector<Entry> & slot = wheel[currentTick%wheelSize];
+            size_t kept = 0;
+            for (size_t i=0; i<slot.size(); ++i)
+            {
+                if (slot[i].tick <= currentTick)
+                {
+                    ready.push_back(slot[i].task);
+                    scheduled--;
+                }
+                else
+                {
+                    slot[kept++] = slot[i];
+                }
+            }
+            slot.erase(slot.begin() + kept,slot.end());
+            virtualClock->set(currentTick*tickNs);
+        }
+        task = ready.front();
+        ready.pop_front();
+    }
+    try {
+        task->execute();
+    }
+    catch (std::exception& e) {
+        ScanLog::getShared()->log(ScanLog::LOG_ERROR,string("scanExecutor task exception ") + e.what());
+    }
+    return true;
+}
+
+size_t ScanExecutor::runUntil(epicsUInt64 time)
+{
+    size_t count = 0;
+    while (true)
+    {
+        {
+            epics::pvData::Lock lock(mutex);
+            if (!virtualClock) throw std::logic_error("runUntil requires a virtual executor");
+            if (ready.empty() && (scheduled == 0 || nextTick()*tickNs > time)) break;
+        }
+        runNext();
+        count++;
+    }
+    virtualClock->set(time);
+    return count;
+}
+
+void ScanExecutor::runTimer()
+{
+    while (true)
+    {
+        double sleep = -1.0;
+        bool due = false;
+        {
+            epics::pvData::Lock lock(mutex);
+            if (stopping) return;
+            if (scheduled > 0)
+            {
+                epicsUInt64 now = clock->now();
+                epicsUInt64 nowTick = now/tickNs;
+                while (currentTick < nowTick && scheduled > 0)
+                {
+                    currentTick++;
+                    std::vector<Entry> & slot = wheel[currentTick%wheelSize];
+                    size_t kept = 0;
+                    for (size_t i=0; i<slot.size(); ++i)
+                    {
+                        if (slot[i].tick <= currentTick)
+                        {
+                            ready.push_back(slot[i].task);
+                            scheduled--;
+                            due = true;
+                        }
+                        else
+                        {
+                            slot[kept++] = slot[i];
+                        }
+                    }
+                    slot.erase(slot.begin() + kept,slot.end());
+                }
+                if (currentTick < nowTick) currentTick = nowTick;
+                if (scheduled > 0)
+                {
+                    // sleep until the next slot that has entries
+                    epicsUInt64 next = currentTick + 1;
+                    while (next < currentTick + wheelSize && wheel[next%wheelSize].empty()) ++next;
+                    wakeTick = next;
+                    sleep = (next*tickNs - now)*1e-9;
+                }
+            }
+            if (scheduled == 0) wakeTick = ~epicsUInt64(0);
+        }
+        if (due) workAvailable.trigger();
+        if (sleep < 0.0) {
+            timerWakeup.wait();
+        } else {
+            timerWakeup.wait(sleep);
+        }
+    }
+}
+
+// a dispatch thread runs submitted tasks, a worker runs timed tasks
+void ScanExecutor::runWorker(bool dispatch)
+{
+    std::deque<Task::shared_pointer> & queue = dispatch ? submitted : ready;
+    epicsEvent & available = dispatch ? dispatchAvailable : workAvailable;
+    while (true)
+    {
+        Task::shared_pointer task;
+        {
+            epics::pvData::Lock lock(mutex);
+            if (stopping)
+            {
+                available.trigger();
+                return;
+            }
+            if (!queue.empty())
+            {
+                task = queue.front();
+                queue.pop_front();
+                // pass the wakeup on to another thread
+                if (!queue.empty()) available.trigger();
+            }
+        }
+        if (!task)
+        {
+            available.wait();
+            continue;
+        }
+        try {
+            task->execute();
+        }
+        catch (std::exception& e) {
+            ScanLog::getShared()->log(ScanLog::LOG_ERROR,string("scanExecutor task exception ") + e.what());
+        }
+    }
+}
+
+}}
@@ -0,0 +1,93 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <algorithm>
+#include <pv/pvDatabase.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+#include "pv/scanHistory.h"
+
+using namespace epics::pvData;
+
+namespace epics { namespace exampleScan {
+
+static StructureConstPtr historyStructure;
+static epicsThreadOnceId historyOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createHistoryStructure(void *)
+{
+    historyStructure = getFieldCreate()->createFieldBuilder()->
+        setId("readbackHistory_t")->
+        add("sequence",pvLong)->
+        add("blocks",pvLong)->
+        addArray("x",pvDouble)->
+        addArray("y",pvDouble)->
+        addArray("time",pvDouble)->
+        createStructure();
+}
+
+StructureConstPtr ScanHistory::getStructure()
+{
+    epicsThreadOnce(&historyOnce,createHistoryStructure,0);
+    return historyStructure;
+}
+
+ScanHistoryPtr ScanHistory::create(
+    PVStructurePtr const & pvHistory,
+    ReadbackHistoryPtr const & history)
+{
+    return ScanHistoryPtr(new ScanHistory(pvHistory,history));
+}
+
+ScanHistory::ScanHistory(
+    PVStructurePtr const & pvHistory,
+    ReadbackHistoryPtr const & history)
+: history(history),
+  pvSequence(pvHistory->getSubFieldT<PVLong>("sequence")),
+  pvBlocks(pvHistory->getSubFieldT<PVLong>("blocks")),
+  pvx(pvHistory->getSubFieldT<PVDoubleArray>("x")),
+  pvy(pvHistory->getSubFieldT<PVDoubleArray>("y")),
+  pvTime(pvHistory->getSubFieldT<PVDoubleArray>("time")),
+  next(0)
+{
+}
+
+static shared_vector<const double> join(
+    const std::vector<HistoryBlock> & blocks,
+    shared_vector<const double> HistoryBlock::*column)
+{
+    // a single block is shared as it is
+    if (blocks.size() == 1) return blocks[0].*column;
+    size_t length = 0;
+    for (size_t i=0; i<blocks.size(); ++i) length += (blocks[i].*column).size();
+    shared_vector<double> joined(length);
+    size_t offset = 0;
+    for (size_t i=0; i<blocks.size(); ++i)
+    {
+        const shared_vector<const double> & part = blocks[i].*column;
+        std::copy(part.begin(),part.end(),joined.begin() + offset);
+        offset += part.size();
+    }
+    return freeze(joined);
+}
+
+bool ScanHistory::put()
+{
+    blocks.clear();
+    next = history->getBlocks(next,blocks);
+    if (blocks.empty()) return false;
+    pvSequence->put(static_cast<int64>(blocks[0].sequence));
+    pvBlocks->put(static_cast<int64>(blocks.size()));
+    pvx->replace(join(blocks,&HistoryBlock::x));
+    pvy->replace(join(blocks,&HistoryBlock::y));
+    pvTime->replace(join(blocks,&HistoryBlock::time));
+    return true;
+}
+
+}}
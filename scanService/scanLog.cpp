@@ -0,0 +1,228 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <epicsThread.h>
+#include <epicsExit.h>
+#include <epicsAtomic.h>
+#include <epicsExport.h>
+#include "pv/scanLog.h"
+
+using namespace std;
+
+namespace epics { namespace exampleScan {
+
+const double ScanLog::pollPeriod = .1;
+
+class ScanLog::Writer : public epicsThreadRunable
+{
+public:
+    Writer(ScanLog & log)
+    : log(log),
+      thread(new epicsThread(
+        *this,
+        "scanLog",
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        epicsThreadPriorityLow))
+    {}
+    virtual void run() { log.run(); }
+    ScanLog & log;
+    std::tr1::shared_ptr<epicsThread> thread;
+};
+
+static ScanLogPtr sharedLog;
+static epicsThreadOnceId sharedOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createShared(void *)
+{
+    ScanLog::Level level = ScanLog::LOG_INFO;
+    const char * value = getenv("SCAN_LOG_LEVEL");
+    if (value)
+    {
+        string name(value);
+        if (name=="error") level = ScanLog::LOG_ERROR;
+        else if (name=="warn") level = ScanLog::LOG_WARN;
+        else if (name=="debug") level = ScanLog::LOG_DEBUG;
+    }
+    sharedLog = ScanLog::create(level);
+}
+
+ScanLogPtr ScanLog::getShared()
+{
+    epicsThreadOnce(&sharedOnce,createShared,0);
+    return sharedLog;
+}
+
+ScanLogPtr ScanLog::create(Level level)
+{
+    ScanLogPtr log(new ScanLog(level));
+    log->writer->thread->start();
+    return log;
+}
+
+ScanLog::ScanLog(Level level)
+: level(level),
+  sequence(0),
+  dropped(0),
+  stopping(false),
+  queueKey(epicsThreadPrivateCreate())
+{
+    writer = std::tr1::shared_ptr<Writer>(new Writer(*this));
+}
+
+ScanLog::~ScanLog()
+{
+    {
+        epics::pvData::Lock lock(mutex);
+        stopping = true;
+    }
+    wakeup.trigger();
+    writer->thread->exitWait();
+    for (size_t i=0; i<queues.size(); ++i)
+    {
+        Queue * queue = queues[i];
+        // a thread that is still running frees its own queue when it exits
+        if (epicsAtomicCmpAndSwapIntT(&queue->state,QUEUE_LIVE,QUEUE_ORPHANED)
+            !=QUEUE_LIVE) delete queue;
+    }
+}
+
+bool ScanLog::isEnabled(Level value)
+{
+    return value <= epicsAtomicGetIntT(&level);
+}
+
+void ScanLog::setLevel(Level value)
+{
+    epicsAtomicSetIntT(&level,value);
+}
+
+size_t ScanLog::getDropped()
+{
+    return epicsAtomicGetSizeT(&dropped);
+}
+
+void ScanLog::threadExit(void * arg)
+{
+    Queue * queue = static_cast<Queue *>(arg);
+    if (epicsAtomicCmpAndSwapIntT(&queue->state,QUEUE_LIVE,QUEUE_EXITED)
+        ==QUEUE_LIVE) return;
+    delete queue;
+}
+
+// the mutex is only taken the first time a thread logs
+ScanLog::Queue * ScanLog::getQueue()
+{
+    Queue * queue = static_cast<Queue *>(epicsThreadPrivateGet(queueKey));
+    if (queue) return queue;
+    queue = new Queue();
+    {
+        epics::pvData::Lock lock(mutex);
+        queues.push_back(queue);
+    }
+    epicsThreadPrivateSet(queueKey,queue);
+    epicsAtThreadExit(threadExit,queue);
+    return queue;
+}
+
+void ScanLog::log(Level value,string const & message)
+{
+    if (!isEnabled(value)) return;
+    Queue * queue = getQueue();
+    size_t tail = queue->tail;
+    size_t head = epicsAtomicGetSizeT(&queue->head);
+    if (tail - head >= queueSize)
+    {
+        epicsAtomicIncrSizeT(&dropped);
+        return;
+    }
+    Message & entry = queue->messages[tail%queueSize];
+    entry.sequence = epicsAtomicIncrSizeT(&sequence);
+    entry.level = value;
+    size_t length = message.size();
+    if (length > maxMessage) length = maxMessage;
+    memcpy(entry.text,message.data(),length);
+    entry.text[length] = 0;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&queue->tail,tail + 1);
+    // trigger takes a lock, so only wake the writer when the queue was empty
+    if (head == tail) wakeup.trigger();
+}
+
+static const char * levelNames[] = {"error","warn","info","debug"};
+
+static bool bySequence(const pair<size_t,string> & a,const pair<size_t,string> & b)
+{
+    return a.first < b.first;
+}
+
+void ScanLog::drain()
+{
+    epics::pvData::Lock drainLock(drainMutex);
+    std::vector<Queue *> current;
+    {
+        epics::pvData::Lock lock(mutex);
+        current = queues;
+    }
+    std::vector<pair<size_t,string> > pending;
+    std::vector<Queue *> exited;
+    for (size_t i=0; i<current.size(); ++i)
+    {
+        Queue * queue = current[i];
+        // read before tail so that a thread seen as exited has nothing left
+        if (epicsAtomicGetIntT(&queue->state)==QUEUE_EXITED) exited.push_back(queue);
+        epicsAtomicReadMemoryBarrier();
+        size_t head = queue->head;
+        size_t tail = epicsAtomicGetSizeT(&queue->tail);
+        epicsAtomicReadMemoryBarrier();
+        for (; head<tail; ++head)
+        {
+            const Message & entry = queue->messages[head%queueSize];
+            pending.push_back(make_pair(entry.sequence,
+                string(levelNames[entry.level]) + " " + entry.text));
+        }
+        epicsAtomicSetSizeT(&queue->head,head);
+    }
+    if (!exited.empty())
+    {
+        epics::pvData::Lock lock(mutex);
+        for (size_t i=0; i<exited.size(); ++i)
+        {
+            queues.erase(find(queues.begin(),queues.end(),exited[i]));
+            delete exited[i];
+        }
+    }
+    if (pending.empty()) return;
+    sort(pending.begin(),pending.end(),bySequence);
+    for (size_t i=0; i<pending.size(); ++i) cout << pending[i].second << "\n";
+    cout.flush();
+}
+
+void ScanLog::flush()
+{
+    drain();
+}
+
+void ScanLog::run()
+{
+    while (true)
+    {
+        // a message that raced with a drain and did not trigger
+        // is picked up at the latest after pollPeriod
+        wakeup.wait(pollPeriod);
+        drain();
+        epics::pvData::Lock lock(mutex);
+        if (stopping) return;
+    }
+}
+
+}}
@@ -0,0 +1,124 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <epicsAtomic.h>
+#include <epicsExport.h>
+#include "pv/scanMetrics.h"
+
+namespace epics { namespace exampleScan {
+
+// values below subBuckets have a bucket each,
+// above that a bucket is 1/subBuckets of its power of two
+size_t LatencyHistogram::bucketIndex(epicsUInt64 value)
+{
+    if (value < subBuckets) return value;
+    size_t msb = 0;
+    for (size_t shift=32; shift>0; shift/=2)
+    {
+        if ((value >> (msb + shift)) != 0) msb += shift;
+    }
+    size_t shift = msb - 4;
+    size_t sub = (value >> shift) & (subBuckets - 1);
+    return subBuckets + shift*subBuckets + sub;
+}
+
+epicsUInt64 LatencyHistogram::bucketLowest(size_t index)
+{
+    if (index < subBuckets) return index;
+    size_t shift = (index - subBuckets)/subBuckets;
+    epicsUInt64 sub = index%subBuckets;
+    return (subBuckets + sub) << shift;
+}
+
+epicsUInt64 LatencyHistogram::bucketHighest(size_t index)
+{
+    if (index < subBuckets) return index;
+    size_t shift = (index - subBuckets)/subBuckets;
+    return bucketLowest(index) + (epicsUInt64(1) << shift) - 1;
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(epicsUInt64 ns)
+{
+    size_t index = bucketIndex(ns);
+    epicsAtomicIncrSizeT(&counts[index]);
+    size_t current = epicsAtomicGetSizeT(&maxIndex);
+    while (index > current)
+    {
+        size_t previous = epicsAtomicCmpAndSwapSizeT(&maxIndex,current,index);
+        if (previous == current) break;
+        current = previous;
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (size_t i=0; i<buckets; ++i) epicsAtomicSetSizeT(&counts[i],0);
+    epicsAtomicSetSizeT(&maxIndex,0);
+}
+
+size_t LatencyHistogram::getCount() const
+{
+    size_t count = 0;
+    for (size_t i=0; i<buckets; ++i) count += epicsAtomicGetSizeT(&counts[i]);
+    return count;
+}
+
+double LatencyHistogram::getMean() const
+{
+    size_t count = 0;
+    double sum = 0.0;
+    for (size_t i=0; i<buckets; ++i)
+    {
+        size_t n = epicsAtomicGetSizeT(&counts[i]);
+        if (n == 0) continue;
+        count += n;
+        sum += double(n)*bucketHighest(i);
+    }
+    return (count > 0) ? sum/count*1e-9 : 0.0;
+}
+
+double LatencyHistogram::getMax() const
+{
+    if (getCount() == 0) return 0.0;
+    return bucketHighest(epicsAtomicGetSizeT(&maxIndex))*1e-9;
+}
+
+double LatencyHistogram::getPercentile(double percentile) const
+{
+    size_t count = getCount();
+    if (count == 0) return 0.0;
+    double target = percentile/100.0*count;
+    size_t seen = 0;
+    for (size_t i=0; i<buckets; ++i)
+    {
+        seen += epicsAtomicGetSizeT(&counts[i]);
+        if (seen > 0 && seen >= target) return bucketHighest(i)*1e-9;
+    }
+    return getMax();
+}
+
+ScanMetricsPtr ScanMetrics::create()
+{
+    return ScanMetricsPtr(new ScanMetrics());
+}
+
+void ScanMetrics::reset()
+{
+    stepLatency.reset();
+    callbackDuration.reset();
+    lockWait.reset();
+    serviceTime.reset();
+}
+
+}}
@@ -13,160 +13,454 @@
 #include <sstream>
 #include <pv/pvDatabase.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
 #include <epicsExport.h>
 #include "pv/scanService.h"
+#include "pv/scanKernel.h"
 
 using namespace std;
 
 namespace epics { namespace exampleScan {
 
+// the tasks hold weak pointers so that a released service is not stepped
+class ScanService::StepTask : public ScanExecutor::Task
+{
+public:
+    StepTask(ScanService::weak_pointer const & service)
+    : service(service)
+    {}
+    virtual void execute()
+    {
+        ScanServicePtr scanService(service.lock());
+        if (scanService) scanService->executeStep();
+    }
+private:
+    ScanService::weak_pointer service;
+};
+
+class ScanService::Dispatcher : public ScanExecutor::Task
+{
+public:
+    Dispatcher(ScanService::weak_pointer const & service, ScanExecutorPtr const & executor)
+    : service(service),
+      executor(executor),
+      head(0),
+      count(0),
+      active(false)
+    {}
+    virtual void execute();
+    void post(int flags);
+    DispatchStats getStats();
+    POINTER_DEFINITIONS(Dispatcher);
+    Dispatcher::weak_pointer self;
+private:
+    ScanService::weak_pointer service;
+    ScanExecutorPtr executor;
+    int queue[dispatchQueueSize];
+    size_t head;
+    size_t count;
+    // true while a drain of the queue is submitted or executing
+    bool active;
+    DispatchStats stats;
+    epics::pvData::Mutex queueMutex;
+};
+
+void ScanService::Dispatcher::post(int flags)
+{
+    {
+        epics::pvData::Lock lock(queueMutex);
+        stats.posted++;
+        if (count > 0)
+        {
+            int & last = queue[(head + count - 1) % dispatchQueueSize];
+            bool completion = (last & ScanService::Callback::SCAN_COMPLETE) != 0;
+            if (!completion || count == dispatchQueueSize)
+            {
+                last |= flags;
+                if (completion) { stats.dropped++; } else { stats.merged++; }
+                return;
+            }
+        }
+        queue[(head + count) % dispatchQueueSize] = flags;
+        count++;
+        if (active) return;
+        active = true;
+    }
+    executor->submit(Dispatcher::shared_pointer(self));
+}
+
+void ScanService::Dispatcher::execute()
+{
+    ScanServicePtr scanService(service.lock());
+    while (true)
+    {
+        int flags;
+        {
+            epics::pvData::Lock lock(queueMutex);
+            if (count == 0)
+            {
+                active = false;
+                return;
+            }
+            flags = queue[head];
+            head = (head + 1) % dispatchQueueSize;
+            count--;
+            stats.delivered++;
+        }
+        if (scanService) scanService->deliver(flags);
+    }
+}
+
+DispatchStats ScanService::Dispatcher::getStats()
+{
+    epics::pvData::Lock lock(queueMutex);
+    return stats;
+}
+
+PointListPlan::shared_pointer PointListPlan::create(
+    epics::pvData::shared_vector<const double> const & x,
+    epics::pvData::shared_vector<const double> const & y)
+{
+    if(x.size()!=y.size()) 
+    {
+        std::stringstream ss;
+        ss << "x and y do not have the same length";
+        throw std::runtime_error(ss.str());
+    }
+    return PointListPlan::shared_pointer(new PointListPlan(x,y));
+}
+
+PointListPlan::shared_pointer PointListPlan::create(const std::vector<Point> & points)
+{
+    epics::pvData::shared_vector<double> x(points.size());
+    epics::pvData::shared_vector<double> y(points.size());
+    for(size_t i=0; i< points.size();  ++i)
+    {
+        x[i] = points[i].x;
+        y[i] = points[i].y;
+    }
+    return create(freeze(x),freeze(y));
+}
 
 ScanServicePtr ScanService::create()
 {
-    return ScanServicePtr(new ScanService());
+    return create(ScanExecutor::getShared());
 }
 
+ScanServicePtr ScanService::create(ScanExecutorPtr const & executor)
+{
+    ScanServicePtr service(new ScanService(executor));
+    service->stepTask = std::tr1::shared_ptr<StepTask>(new StepTask(service));
+    service->dispatcher = std::tr1::shared_ptr<Dispatcher>(new Dispatcher(service,executor));
+    service->dispatcher->self = service->dispatcher;
+    return service;
+}
 
-ScanService::ScanService()
+
+ScanService::ScanService(ScanExecutorPtr const & executor)
 : scanningActive(false),
   index(0),
   flags(0),
   stepDelay(.1),
   stepDistance(.01),
-  debug(false)
+  debug(false),
+  periodNs(100000000),
+  deadline(0),
+  lastStepStart(0),
+  intervalSum(0.0),
+  intervalSumSquares(0.0),
+  intervals(0),
+  holdSum(0.0),
+  stepScheduled(false),
+  awaitingSetpoint(false),
+  scanStart(0),
+  snapshotSequence(0),
+  executor(executor),
+  metrics(ScanMetrics::create()),
+  traceBuffer(ScanTrace::getShared()),
+  traceSource(traceBuffer->createSource()),
+  logger(ScanLog::getShared()),
+  history(ReadbackHistory::create(historyBlockSize,historyBlockCount)),
+  wallOffset(0.0)
 {
-   thread = EpicsThreadPtr(new epicsThread(
-        *this,
-        "scanService",
-        epicsThreadGetStackSize(epicsThreadStackSmall),
-        epicsThreadPriorityLow));
-        startThread();
+    setWallOffset();
+    publishSnapshot();
 }
 
-void ScanService::run()
+// the steps read the executor clock, the history needs wall clock time
+void ScanService::setWallOffset()
 {
-    while (true)
+    epicsTimeStamp wall;
+    epicsTimeGetCurrent(&wall);
+    epicsUInt64 now = executor->now();
+    wallOffset = (wall.secPastEpoch + POSIX_TIME_AT_EPICS_EPOCH) + wall.nsec*1e-9 - now*1e-9;
+}
+
+void ScanService::executeStep()
+{
+    epicsUInt64 next = 0;
+    bool reschedule = false;
+    try {
+        epicsUInt64 now = executor->now();
+        epics::pvData::Lock lock(mutex);
+        epicsUInt64 locked = epicsMonotonicGet();
+        epicsUInt64 late = (now > deadline) ? now - deadline : 0;
+        recordStepStart(deadline,now);
+        if (periodNs>0 && now > deadline && now - deadline > maxCatchUpSteps*periodNs)
+        {
+            epicsUInt64 skipped = (now - deadline)/periodNs;
+            stepStats.skippedDeadlines += skipped;
+            deadline += skipped*periodNs;
+        }
+        step();
+        if (awaitingSetpoint && (flags & ScanService::Callback::SETPOINT_CHANGED) != 0)
+        {
+            stepStats.startLatency = (now - scanStart)*1e-9;
+            awaitingSetpoint = false;
+        }
+        publishSnapshot();
+        deadline += periodNs;
+        next = deadline;
+        // an idle service is not stepped until the next startScan
+        reschedule = scanningActive;
+        stepScheduled = reschedule;
+        epicsUInt64 heldNs = epicsMonotonicGet() - locked;
+        metrics->getStepLatency().record(late + heldNs);
+        double held = heldNs*1e-9;
+        holdSum += held;
+        if (held > stepStats.maxHoldTime) stepStats.maxHoldTime = held;
+    }
+    catch (...) { abort(); }
+    update();
+    if (reschedule) executor->schedule(stepTask,next);
+}
+
+// caller must hold mutex
+void ScanService::scheduleStep()
+{
+    // A step still scheduled from a scan that was stopped within the last
+    // period is kept. It runs at its old deadline, at most one period away.
+    if (stepScheduled) return;
+    stepScheduled = true;
+    executor->schedule(stepTask,deadline);
+}
+
+void ScanService::step()
+{
+    if (scanningActive)
     {
-        try {
-            epicsThreadSleep(stepDelay);
-            epics::pvData::Lock lock(mutex);
-            if (scanningActive)
-            {
-                if (positionRB != positionSP)
-                {
-                    double dx = positionSP.x - positionRB.x;
-                    double dy = positionSP.y - positionRB.y;
-                    double absx = abs(dx);
-                    double del = stepDistance*.01;
-                    if(absx<=(stepDistance+del)) dx = 0.0;
-                    double absy = abs(dy);
-                    if(absy<=(stepDistance+del)) dy = 0.0;
-                    if(dx==0.0 && dy==0.0) {
-                        setReadback(positionSP);
-                        continue;
-                    }
-                    bool dxLarger = (absx>absy) ? true : false;
-                    if(dx!=0.0) {
-                        if(dx>0.0) {dx = stepDistance;} else {dx = -stepDistance;}
-                        if(!dxLarger && dy!=0.0) dx = dx*(absx/absy);
-                    }
-                    if(dy!=0.0) {
-                        if(dy>0.0) {dy = stepDistance;} else {dy = -stepDistance;}
-                        if(dxLarger && dx!=0.0) dy = dy*(absy/absx);
-                    }
-                    setReadback(Point(positionRB.x + dx, positionRB.y + dy));
-                }
-            }
-            if (scanningActive && positionRB == positionSP)
-            {
-                if (index < points.size())
-                {
-                    setSetpoint(points[index]);
-                    ++index;
-                }
-                else
-                {
-                    flags |= ScanService::Callback::SCAN_COMPLETE;
-                    stopScan();
-                }
+        if (positionRB != positionSP)
+        {
+            PointN<2> sp;
+            sp[0] = positionSP.x;
+            sp[1] = positionSP.y;
+            PointN<2> rb;
+            rb[0] = positionRB.x;
+            rb[1] = positionRB.y;
+            if (stepToward(sp,rb,stepDistance)) {
+                setReadback(positionSP);
+                return;
             }
+            setReadback(Point(rb[0],rb[1]));
+        }
+    }
+    if (scanningActive && positionRB == positionSP)
+    {
+        if (index < plan->size())
+        {
+            setSetpoint(plan->getPoint(index));
+            ++index;
+        }
+        else
+        {
+            flags |= ScanService::Callback::SCAN_COMPLETE;
+            stopScan();
         }
-        catch (...) { abort(); }
-        update();
     }
 }
 
-void ScanService::registerCallback(Callback::shared_pointer const & callback)
+void ScanService::recordStepStart(epicsUInt64 deadline,epicsUInt64 now)
+{
+    epicsUInt64 late = (now > deadline) ? now - deadline : 0;
+    if (periodNs > 0 && late >= periodNs) stepStats.missedDeadlines++;
+    double lateness = late*1e-9;
+    if (lateness > stepStats.maxLateness) stepStats.maxLateness = lateness;
+    if (stepStats.steps > 0)
+    {
+        double interval = (now - lastStepStart)*1e-9;
+        intervalSum += interval;
+        intervalSumSquares += interval*interval;
+        intervals++;
+    }
+    lastStepStart = now;
+    stepStats.steps++;
+}
+
+StepStats ScanService::getStepStats()
+{
+    epics::pvData::Lock lock(mutex);
+    StepStats stats(stepStats);
+    stats.targetPeriod = periodNs*1e-9;
+    stats.tick = executor->getTick();
+    if (intervals > 0)
+    {
+        double mean = intervalSum/intervals;
+        double variance = intervalSumSquares/intervals - mean*mean;
+        stats.achievedPeriod = mean;
+        stats.jitter = (variance > 0.0) ? sqrt(variance) : 0.0;
+    }
+    if (stats.steps > 0) stats.meanHoldTime = holdSum/stats.steps;
+    return stats;
+}
+
+void ScanService::resetStepStats()
 {
     epics::pvData::Lock lock(mutex);
-    if (find(callbacks.begin(),callbacks.end(), callback) != callbacks.end()) return;
-    callbacks.push_back(callback);
+    stepStats = StepStats();
+    intervalSum = 0.0;
+    intervalSumSquares = 0.0;
+    intervals = 0;
+    holdSum = 0.0;
+}
+
+void ScanService::registerCallback(Callback::shared_pointer const & callback)
+{
+    callbacks.add(callback);
 }
 
 bool ScanService::unregisterCallback(ScanService::Callback::shared_pointer const & callback)
 {
-    epics::pvData::Lock lock(mutex);
-    std::vector<Callback::shared_pointer>::iterator foundCB
-        = find(callbacks.begin(),callbacks.end(), callback);
-    bool found = foundCB == callbacks.end();
-    if(found) callbacks.erase(foundCB);
-    return found;
+    return callbacks.remove(callback);
 }
 
 void ScanService::update()
 {
     epics::pvData::Lock lock(mutex);
-    std::vector<Callback::shared_pointer> callbacks = this->callbacks;
-
     if (flags != 0)
     {
-        for (std::vector<Callback::shared_pointer>::iterator
-                 it = callbacks.begin();
-             it != callbacks.end(); ++it)
-        {
+        if (postObserver) postObserver->update(flags);
+        dispatcher->post(flags);
+        flags = 0;
+    }
+}
+
+void ScanService::setPostObserver(Callback::shared_pointer const & observer)
+{
+    epics::pvData::Lock lock(mutex);
+    postObserver = observer;
+}
+
+// called by the dispatcher thread without holding mutex
+void ScanService::deliver(int flags)
+{
+    const CallbackRegistry<Callback::shared_pointer>::List & list = callbacks.acquire();
+    for (CallbackRegistry<Callback::shared_pointer>::List::const_iterator
+             it = list.begin();
+         it != list.end(); ++it)
+    {
+        trace(ScanTrace::CALLBACK_ENTER,flags);
+        try {
+            LatencyTimer timer(metrics->getCallbackDuration());
             (*it)->update(flags);
         }
-
-        flags = 0;
+        catch (std::exception& e) {
+            logger->log(ScanLog::LOG_ERROR,string("scanService callback exception ") + e.what());
+        }
+        trace(ScanTrace::CALLBACK_EXIT,flags);
     }
+    callbacks.release();
+}
+
+DispatchStats ScanService::getDispatchStats()
+{
+    return dispatcher->getStats();
 }
 
 Point ScanService::getPositionSetpoint()
 {
-    return positionSP;
+    return getSnapshot().setpoint;
 }
 
 Point ScanService::getPositionReadback()
 {
-    return positionRB;
+    return getSnapshot().readback;
+}
+
+ScanSnapshot ScanService::getSnapshot()
+{
+    while (true)
+    {
+        size_t before = epicsAtomicGetSizeT(&snapshotSequence);
+        epicsAtomicReadMemoryBarrier();
+        if ((before & 1) != 0) continue;
+        ScanSnapshot copy(snapshot);
+        epicsAtomicReadMemoryBarrier();
+        if (epicsAtomicGetSizeT(&snapshotSequence) == before) return copy;
+    }
+}
+
+// caller must hold mutex so that there is only one writer
+void ScanService::publishSnapshot()
+{
+    epicsAtomicIncrSizeT(&snapshotSequence);
+    epicsAtomicWriteMemoryBarrier();
+    snapshot.setpoint = positionSP;
+    snapshot.readback = positionRB;
+    snapshot.index = index;
+    snapshot.total = plan ? plan->size() : 0;
+    snapshot.active = scanningActive;
+    snapshot.stepDelay = stepDelay;
+    snapshot.stepDistance = stepDistance;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicIncrSizeT(&snapshotSequence);
 }
 
 void ScanService::setSetpoint(Point sp)
 {
     positionSP = sp;
     flags |= ScanService::Callback::SETPOINT_CHANGED;
+    trace(ScanTrace::SETPOINT,sp.x,sp.y);
 }
 
 void ScanService::setReadback(Point rb)
 {
     positionRB = rb;
     flags |= ScanService::Callback::READBACK_CHANGED;
+    // lastStepStart is the time of the step that moved the readback
+    if (history->add(rb.x,rb.y,lastStepStart*1e-9 + wallOffset))
+    {
+        flags |= ScanService::Callback::HISTORY_CHANGED;
+    }
+    trace(ScanTrace::READBACK,rb.x,rb.y);
 }
 
 void ScanService::configure(const std::vector<Point> & newPoints)
 {
-    epics::pvData::Lock lock(mutex);
-    if(scanningActive) 
+    configure(PointListPlan::create(newPoints));
+}
+
+void ScanService::configure(ScanPlanPtr const & newPlan)
+{
     {
-        std::stringstream ss;
-        ss << "Cannot configure while scanning active ";
-        throw std::runtime_error(ss.str());
+        epics::pvData::Lock lock(mutex);
+        if(scanningActive) 
+        {
+            std::stringstream ss;
+            ss << "Cannot configure while scanning active ";
+            throw std::runtime_error(ss.str());
+        }
+        plan = newPlan;
+        publishSnapshot();
     }
-    points = newPoints;
+    trace(ScanTrace::CONFIGURE,newPlan->size());
     if(debug) {
-       cout << "configure";
-       for(size_t i=0; i< newPoints.size();  ++i) cout << " " << points[i];
-       cout << "\n";
+       // only the first few points, a large plan would flood the queue
+       std::stringstream ss;
+       ss << "configure " << newPlan->size() << " points";
+       for(size_t i=0; i< newPlan->size() && i<4;  ++i) ss << " " << newPlan->getPoint(i);
+       if(newPlan->size()>4) ss << " ...";
+       logger->log(ScanLog::LOG_INFO,ss.str());
     }
 }
 
@@ -179,14 +473,23 @@ void ScanService::startScan()
         ss << "Cannot startScan while scanning active ";
         throw std::runtime_error(ss.str());
     }
-    if(points.size()<=0) {
+    if(!plan || plan->size()<=0) {
         std::stringstream ss;
         ss << "Cannot startScan because no points.";
         throw std::runtime_error(ss.str());
     }
-    if(debug) cout << "startScan\n";
+    if(debug) logger->log(ScanLog::LOG_INFO,"startScan");
+    resetStepStats();
+    setWallOffset();
     index = 0;
     scanningActive = true;
+    publishSnapshot();
+    trace(ScanTrace::SCAN_START,plan->size());
+    epicsUInt64 now = executor->now();
+    scanStart = now;
+    awaitingSetpoint = true;
+    if (!stepScheduled) deadline = now;
+    scheduleStep();
 }
 
 void ScanService::stopScan()
@@ -194,12 +497,15 @@ void ScanService::stopScan()
     epics::pvData::Lock lock(mutex);
     if(!scanningActive) 
     {
-        cout << "stopScan called but scan is not active\n";
+        logger->log(ScanLog::LOG_DEBUG,"stopScan called but scan is not active");
         return;
     }
-    if(debug) cout << "stopScan\n";
+    if(debug) logger->log(ScanLog::LOG_INFO,"stopScan");
     flags |= ScanService::Callback::SCAN_COMPLETE;
+    if (history->flush()) flags |= ScanService::Callback::HISTORY_CHANGED;
     scanningActive = false;
+    publishSnapshot();
+    trace(ScanTrace::SCAN_STOP,index);
 }
 
 void ScanService::setRate(double stepDelay,double stepDistance)
@@ -211,17 +517,80 @@ void ScanService::setRate(double stepDelay,double stepDistance)
         ss << "Cannot setRate while scanning active";
         throw std::runtime_error(ss.str());
     }
-    if(debug) cout << "setRate stepDelay " << stepDelay << " stepDistance " << stepDistance << "\n"; 
+    if(debug) {
+        std::stringstream ss;
+        ss << "setRate stepDelay " << stepDelay << " stepDistance " << stepDistance;
+        logger->log(ScanLog::LOG_INFO,ss.str());
+    }
     this->stepDelay = stepDelay;
     this->stepDistance = stepDistance;
+    periodNs = (stepDelay > 0.0) ? static_cast<epicsUInt64>(stepDelay*1e9) : 0;
+    publishSnapshot();
 }
 
 void ScanService::setDebug(bool value)
 {
-    if(debug) cout << "setDebug " << (value ? "true" : "false") << "\n";
+    if(debug) logger->log(ScanLog::LOG_INFO,string("setDebug ") + (value ? "true" : "false"));
     debug = value;
 }
 
+void ScanService::Batch::configure(ScanPlanPtr const & plan)
+{
+    Command command(CONFIGURE);
+    command.plan = plan;
+    commands.push_back(command);
+}
+
+void ScanService::Batch::startScan()
+{
+    commands.push_back(Command(START_SCAN));
+}
+
+void ScanService::Batch::stopScan()
+{
+    commands.push_back(Command(STOP_SCAN));
+}
+
+void ScanService::Batch::setRate(double stepDelay,double stepDistance)
+{
+    Command command(SET_RATE);
+    command.stepDelay = stepDelay;
+    command.stepDistance = stepDistance;
+    commands.push_back(command);
+}
+
+void ScanService::Batch::setDebug(bool value)
+{
+    Command command(SET_DEBUG);
+    command.value = value;
+    commands.push_back(command);
+}
+
+// the mutex is recursive so each command takes it again
+size_t ScanService::execute(Batch const & batch,string & error)
+{
+    epics::pvData::Lock lock(mutex);
+    size_t done = 0;
+    try {
+        for (; done<batch.commands.size(); ++done)
+        {
+            const Batch::Command & command = batch.commands[done];
+            switch (command.type)
+            {
+            case Batch::CONFIGURE: configure(command.plan); break;
+            case Batch::START_SCAN: startScan(); break;
+            case Batch::STOP_SCAN: stopScan(); break;
+            case Batch::SET_RATE: setRate(command.stepDelay,command.stepDistance); break;
+            case Batch::SET_DEBUG: setDebug(command.value); break;
+            }
+        }
+    }
+    catch (std::exception& e) {
+        error = e.what();
+    }
+    return done;
+}
+
 
 }}
 
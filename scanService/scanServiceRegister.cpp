@@ -0,0 +1,58 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <string>
+#include <iostream>
+
+#include <iocsh.h>
+
+#include <pv/scanTrace.h>
+
+#include <epicsExport.h>
+
+using namespace epics::exampleScan;
+using std::cout;
+using std::endl;
+
+// iocsh commands of the scan service library, registered once however
+// many of the scan servers an IOC links
+
+static const iocshArg dumpArg0 = { "fileName", iocshArgString };
+static const iocshArg *dumpArgs[] = {
+    &dumpArg0};
+
+static const iocshFuncDef scanTraceDumpFuncDef = {
+    "scanTraceDump", 1, dumpArgs};
+static void scanTraceDumpCallFunc(const iocshArgBuf *args)
+{
+    char *fileName = args[0].sval;
+    if(!fileName) {
+        cout << "scanTraceDump fileName" << endl;
+        return;
+    }
+    try {
+        size_t count = ScanTrace::getShared()->dump(fileName);
+        cout << "scanTraceDump wrote " << count << " events" << endl;
+    } catch (std::exception& e) {
+        cout << "scanTraceDump " << e.what() << endl;
+    }
+}
+
+static void scanServiceRegister(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        firstTime = 0;
+        iocshRegister(&scanTraceDumpFuncDef, scanTraceDumpCallFunc);
+    }
+}
+
+extern "C" {
+    epicsExportRegistrar(scanServiceRegister);
+}
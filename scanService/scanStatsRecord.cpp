@@ -0,0 +1,223 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <pv/standardField.h>
+#include <epicsExport.h>
+#include "pv/scanStatsRecord.h"
+
+using namespace epics::pvData;
+using namespace epics::pvDatabase;
+using std::string;
+
+namespace epics { namespace exampleScan {
+
+const double ScanStatsRecord::refreshPeriod = 1.0;
+
+// holds a weak pointer so that a removed record stops being refreshed
+class ScanStatsRecord::RefreshTask : public ScanExecutor::Task
+{
+public:
+    RefreshTask(ScanStatsRecord::weak_pointer const & record,ScanExecutorPtr const & executor)
+    : record(record),
+      executor(executor)
+    {}
+    virtual void execute()
+    {
+        ScanStatsRecordPtr statsRecord(record.lock());
+        if (!statsRecord) return;
+        statsRecord->refresh();
+        schedule();
+    }
+    void schedule()
+    {
+        executor->schedule(self.lock(),
+            executor->now() + static_cast<epicsUInt64>(refreshPeriod*1e9));
+    }
+    std::tr1::weak_ptr<RefreshTask> self;
+private:
+    ScanStatsRecord::weak_pointer record;
+    ScanExecutorPtr executor;
+};
+
+static StructureConstPtr makeHistogramStructure()
+{
+    static StructureConstPtr histogramStructure;
+    if (!histogramStructure)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        histogramStructure = fieldCreate->createFieldBuilder()->
+            setId("histogram_t")->
+            add("count",pvLong)->
+            add("mean",pvDouble)->
+            add("p50",pvDouble)->
+            add("p90",pvDouble)->
+            add("p99",pvDouble)->
+            add("p999",pvDouble)->
+            add("max",pvDouble)->
+            createStructure();
+    }
+    return histogramStructure;
+}
+
+static StructureConstPtr makeStepStatsStructure()
+{
+    static StructureConstPtr stepStatsStructure;
+    if (!stepStatsStructure)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        stepStatsStructure = fieldCreate->createFieldBuilder()->
+            setId("stepStats_t")->
+            add("steps",pvLong)->
+            add("missedDeadlines",pvLong)->
+            add("skippedDeadlines",pvLong)->
+            add("targetPeriod",pvDouble)->
+            add("achievedPeriod",pvDouble)->
+            add("jitter",pvDouble)->
+            add("maxLateness",pvDouble)->
+            add("startLatency",pvDouble)->
+            add("meanHoldTime",pvDouble)->
+            add("maxHoldTime",pvDouble)->
+            add("tick",pvDouble)->
+            createStructure();
+    }
+    return stepStatsStructure;
+}
+
+static StructureConstPtr makeRecordStructure()
+{
+    static StructureConstPtr recordStructure;
+    if (!recordStructure)
+    {
+        FieldCreatePtr fieldCreate = getFieldCreate();
+
+        recordStructure = fieldCreate->createFieldBuilder()->
+            add("reset",pvBoolean)->
+            add("stepLatency",makeHistogramStructure())->
+            add("callbackDuration",makeHistogramStructure())->
+            add("lockWait",makeHistogramStructure())->
+            add("serviceTime",makeHistogramStructure())->
+            add("stepStats",makeStepStatsStructure())->
+            add("timeStamp", getStandardField()->timeStamp())->
+            createStructure();
+    }
+    return recordStructure;
+}
+
+ScanStatsRecordPtr ScanStatsRecord::create(
+    string const & recordName,
+    ScanServicePtr const & scanService)
+{
+    PVStructurePtr pvStructure = getPVDataCreate()->createPVStructure(makeRecordStructure());
+    ScanStatsRecordPtr pvRecord(
+        new ScanStatsRecord(recordName,pvStructure,scanService));
+    pvRecord->initPvt();
+    return pvRecord;
+}
+
+ScanStatsRecord::ScanStatsRecord(
+    string const & recordName,
+    PVStructurePtr const & pvStructure,
+    ScanServicePtr const & scanService)
+: PVRecord(recordName,pvStructure),
+  scanService(scanService),
+  metrics(scanService->getMetrics()),
+  executor(scanService->getExecutor())
+{
+    pvReset = pvStructure->getSubFieldT<PVBoolean>("reset");
+    attach(stepLatency,"stepLatency");
+    attach(callbackDuration,"callbackDuration");
+    attach(lockWait,"lockWait");
+    attach(serviceTime,"serviceTime");
+    pvStepStats = pvStructure->getSubFieldT<PVStructure>("stepStats");
+}
+
+void ScanStatsRecord::initPvt()
+{
+    initPVRecord();
+    refreshTask = std::tr1::shared_ptr<RefreshTask>(new RefreshTask(
+        std::tr1::dynamic_pointer_cast<ScanStatsRecord>(shared_from_this()),executor));
+    refreshTask->self = refreshTask;
+    refreshTask->schedule();
+}
+
+void ScanStatsRecord::attach(HistogramFields & fields,const char * name)
+{
+    PVStructurePtr pvHistogram(getPVStructure()->getSubFieldT<PVStructure>(name));
+    fields.count = pvHistogram->getSubFieldT<PVLong>("count");
+    fields.mean = pvHistogram->getSubFieldT<PVDouble>("mean");
+    fields.p50 = pvHistogram->getSubFieldT<PVDouble>("p50");
+    fields.p90 = pvHistogram->getSubFieldT<PVDouble>("p90");
+    fields.p99 = pvHistogram->getSubFieldT<PVDouble>("p99");
+    fields.p999 = pvHistogram->getSubFieldT<PVDouble>("p999");
+    fields.max = pvHistogram->getSubFieldT<PVDouble>("max");
+}
+
+void ScanStatsRecord::put(HistogramFields & fields,LatencyHistogram const & histogram)
+{
+    fields.count->put(histogram.getCount());
+    fields.mean->put(histogram.getMean());
+    fields.p50->put(histogram.getPercentile(50.0));
+    fields.p90->put(histogram.getPercentile(90.0));
+    fields.p99->put(histogram.getPercentile(99.0));
+    fields.p999->put(histogram.getPercentile(99.9));
+    fields.max->put(histogram.getMax());
+}
+
+void ScanStatsRecord::putStepStats()
+{
+    StepStats stats(scanService->getStepStats());
+    pvStepStats->getSubFieldT<PVLong>("steps")->put(stats.steps);
+    pvStepStats->getSubFieldT<PVLong>("missedDeadlines")->put(stats.missedDeadlines);
+    pvStepStats->getSubFieldT<PVLong>("skippedDeadlines")->put(stats.skippedDeadlines);
+    pvStepStats->getSubFieldT<PVDouble>("targetPeriod")->put(stats.targetPeriod);
+    pvStepStats->getSubFieldT<PVDouble>("achievedPeriod")->put(stats.achievedPeriod);
+    pvStepStats->getSubFieldT<PVDouble>("jitter")->put(stats.jitter);
+    pvStepStats->getSubFieldT<PVDouble>("maxLateness")->put(stats.maxLateness);
+    pvStepStats->getSubFieldT<PVDouble>("startLatency")->put(stats.startLatency);
+    pvStepStats->getSubFieldT<PVDouble>("meanHoldTime")->put(stats.meanHoldTime);
+    pvStepStats->getSubFieldT<PVDouble>("maxHoldTime")->put(stats.maxHoldTime);
+    pvStepStats->getSubFieldT<PVDouble>("tick")->put(stats.tick);
+}
+
+void ScanStatsRecord::refresh()
+{
+    lock();
+    try {
+        process();
+    }
+    catch(...)
+    {
+        unlock();
+        throw;
+    }
+    unlock();
+}
+
+// called with the record locked
+void ScanStatsRecord::process()
+{
+    if (pvReset->get())
+    {
+        metrics->reset();
+        scanService->resetStepStats();
+        pvReset->put(false);
+    }
+    beginGroupPut();
+    put(stepLatency,metrics->getStepLatency());
+    put(callbackDuration,metrics->getCallbackDuration());
+    put(lockWait,metrics->getLockWait());
+    put(serviceTime,metrics->getServiceTime());
+    putStepStats();
+    PVRecord::process();
+    endGroupPut();
+}
+
+}}
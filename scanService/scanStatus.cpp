@@ -0,0 +1,84 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <stdexcept>
+#include <pv/pvDatabase.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+#include "pv/scanStatus.h"
+
+using namespace epics::pvData;
+
+namespace epics { namespace exampleScan {
+
+static StructureConstPtr statusStructure;
+static epicsThreadOnceId statusOnce = EPICS_THREAD_ONCE_INIT;
+
+// the order of the fields is the layout put relies on
+enum StatusField {
+    POSITION_SP = 0,
+    POSITION_RB,
+    INDEX,
+    TOTAL,
+    STATE,
+    STEP_DELAY,
+    STEP_DISTANCE
+};
+
+static void createStatusStructure(void *)
+{
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    StructureConstPtr pointStructure = fieldCreate->createFieldBuilder()->
+        setId("point_t")->
+        add("x",pvDouble)->
+        add("y",pvDouble)->
+        createStructure();
+    statusStructure = fieldCreate->createFieldBuilder()->
+        setId("scanStatus_t")->
+        add("positionSP",pointStructure)->
+        add("positionRB",pointStructure)->
+        add("index",pvLong)->
+        add("total",pvLong)->
+        add("state",pvString)->
+        add("stepDelay",pvDouble)->
+        add("stepDistance",pvDouble)->
+        createStructure();
+}
+
+StructureConstPtr ScanStatus::getStructure()
+{
+    epicsThreadOnce(&statusOnce,createStatusStructure,0);
+    return statusStructure;
+}
+
+static void putPoint(PVFieldPtr const & pvField,const Point & point)
+{
+    const PVFieldPtrArray & fields = static_cast<PVStructure *>(pvField.get())->getPVFields();
+    static_cast<PVDouble *>(fields[0].get())->put(point.x);
+    static_cast<PVDouble *>(fields[1].get())->put(point.y);
+}
+
+void ScanStatus::put(PVStructurePtr const & pvStatus,ScanSnapshot const & snapshot)
+{
+    StructureConstPtr structure = pvStatus->getStructure();
+    if (structure != getStructure() && !(*structure == *getStructure()))
+    {
+        throw std::logic_error("ScanStatus::put structure is not the status structure");
+    }
+    const PVFieldPtrArray & fields = pvStatus->getPVFields();
+    putPoint(fields[POSITION_SP],snapshot.setpoint);
+    putPoint(fields[POSITION_RB],snapshot.readback);
+    static_cast<PVLong *>(fields[INDEX].get())->put(static_cast<int64>(snapshot.index));
+    static_cast<PVLong *>(fields[TOTAL].get())->put(static_cast<int64>(snapshot.total));
+    static_cast<PVString *>(fields[STATE].get())->put(snapshot.active ? "active" : "idle");
+    static_cast<PVDouble *>(fields[STEP_DELAY].get())->put(snapshot.stepDelay);
+    static_cast<PVDouble *>(fields[STEP_DISTANCE].get())->put(snapshot.stepDistance);
+}
+
+}}
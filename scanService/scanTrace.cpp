@@ -0,0 +1,141 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <epicsExport.h>
+#include "pv/scanTrace.h"
+
+using std::string;
+
+namespace epics { namespace exampleScan {
+
+static ScanTracePtr sharedTrace;
+static epicsThreadOnceId sharedOnce = EPICS_THREAD_ONCE_INIT;
+
+static void createShared(void *)
+{
+    sharedTrace = ScanTrace::create();
+    const char * directory = getenv("SCAN_TRACE_DIR");
+    if (directory) sharedTrace->setDumpDirectory(directory);
+}
+
+ScanTracePtr ScanTrace::getShared()
+{
+    epicsThreadOnce(&sharedOnce,createShared,0);
+    return sharedTrace;
+}
+
+ScanTracePtr ScanTrace::create()
+{
+    return ScanTracePtr(new ScanTrace());
+}
+
+ScanTrace::ScanTrace()
+: events(new TraceEvent[capacity]),
+  next(0),
+  sources(0),
+  enabled(1)
+{
+    memset(events,0,capacity*sizeof(TraceEvent));
+}
+
+ScanTrace::~ScanTrace()
+{
+    delete[] events;
+}
+
+epicsUInt32 ScanTrace::createSource()
+{
+    return static_cast<epicsUInt32>(epicsAtomicIncrSizeT(&sources));
+}
+
+void ScanTrace::record(EventType type,epicsUInt32 source,double a,double b)
+{
+    if (!epicsAtomicGetIntT(&enabled)) return;
+    size_t position = epicsAtomicIncrSizeT(&next) - 1;
+    TraceEvent & event = events[position%capacity];
+    // invalidate the slot while it is written
+    epicsAtomicSetSizeT(&event.sequence,0);
+    epicsAtomicWriteMemoryBarrier();
+    event.time = epicsMonotonicGet();
+    event.type = type;
+    event.source = source;
+    event.a = a;
+    event.b = b;
+    epicsAtomicWriteMemoryBarrier();
+    epicsAtomicSetSizeT(&event.sequence,position + 1);
+}
+
+void ScanTrace::setEnabled(bool value)
+{
+    epicsAtomicSetIntT(&enabled,value ? 1 : 0);
+}
+
+bool ScanTrace::isEnabled()
+{
+    return epicsAtomicGetIntT(&enabled) != 0;
+}
+
+size_t ScanTrace::dump(string const & fileName)
+{
+    size_t end = epicsAtomicGetSizeT(&next);
+    size_t begin = (end > capacity) ? end - capacity : 0;
+    std::vector<TraceEvent> copy;
+    copy.reserve(end - begin);
+    for (size_t position=begin; position<end; ++position)
+    {
+        const TraceEvent & event = events[position%capacity];
+        if (epicsAtomicGetSizeT(&event.sequence) != position + 1) continue;
+        epicsAtomicReadMemoryBarrier();
+        TraceEvent value = event;
+        epicsAtomicReadMemoryBarrier();
+        // skip an event that was overwritten while it was copied
+        if (epicsAtomicGetSizeT(&event.sequence) != position + 1) continue;
+        copy.push_back(value);
+    }
+    FILE * file = fopen(fileName.c_str(),"wb");
+    if (!file) throw std::runtime_error("cannot open " + fileName);
+    epicsUInt32 header[2];
+    header[0] = static_cast<epicsUInt32>(copy.size());
+    header[1] = sizeof(TraceEvent);
+    bool ok = fwrite("SCANTRC1",1,8,file) == 8
+        && fwrite(header,sizeof(header),1,file) == 1
+        && (copy.empty() || fwrite(&copy[0],sizeof(TraceEvent),copy.size(),file) == copy.size());
+    if (fclose(file) != 0) ok = false;
+    if (!ok) throw std::runtime_error("cannot write " + fileName);
+    return copy.size();
+}
+
+void ScanTrace::setDumpDirectory(string const & directory)
+{
+    dumpDirectory = directory;
+}
+
+size_t ScanTrace::dumpNamed(string const & name)
+{
+    if (dumpDirectory.empty())
+    {
+        throw std::runtime_error("trace dumps by name are disabled, SCAN_TRACE_DIR is not set");
+    }
+    if (name.empty() || name.find_first_of("/\\") != string::npos
+    || name.find("..") != string::npos)
+    {
+        throw std::runtime_error("trace dump name must be a plain file name");
+    }
+    return dump(dumpDirectory + "/" + name);
+}
+
+}}
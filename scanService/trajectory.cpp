@@ -0,0 +1,172 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * @date 2019.06
+ */
+
+#include <cmath>
+#include <sstream>
+#include <pv/pvDatabase.h>
+#include <epicsExport.h>
+#include "pv/trajectory.h"
+
+using namespace epics::pvData;
+using std::string;
+
+namespace epics { namespace exampleScan {
+
+static const double twoPi = 2.0*3.14159265358979323846;
+
+static void checkCount(size_t count, const char * name)
+{
+    if (count > 0) return;
+    std::stringstream ss;
+    ss << name << " must be greater than 0";
+    throw std::runtime_error(ss.str());
+}
+
+RasterPlan::shared_pointer RasterPlan::create(
+    double xStart, double xStop, size_t nx,
+    double yStart, double yStop, size_t ny,
+    bool serpentine)
+{
+    checkCount(nx,"nx");
+    checkCount(ny,"ny");
+    return RasterPlan::shared_pointer(
+        new RasterPlan(xStart,xStop,nx,yStart,yStop,ny,serpentine));
+}
+
+RasterPlan::RasterPlan(
+    double xStart, double xStop, size_t nx,
+    double yStart, double yStop, size_t ny,
+    bool serpentine)
+: xStart(xStart),
+  xStep((nx > 1) ? (xStop - xStart)/(nx - 1) : 0.0),
+  nx(nx),
+  yStart(yStart),
+  yStep((ny > 1) ? (yStop - yStart)/(ny - 1) : 0.0),
+  ny(ny),
+  serpentine(serpentine)
+{
+}
+
+Point RasterPlan::getPoint(size_t index) const
+{
+    size_t row = index/nx;
+    size_t column = index%nx;
+    if (serpentine && (row & 1) != 0) column = nx - 1 - column;
+    return Point(xStart + column*xStep, yStart + row*yStep);
+}
+
+GridPlan::shared_pointer GridPlan::create(
+    double xStart, double xStep, size_t nx,
+    double yStart, double yStep, size_t ny)
+{
+    checkCount(nx,"nx");
+    checkCount(ny,"ny");
+    return GridPlan::shared_pointer(
+        new GridPlan(xStart,xStep,nx,yStart,yStep,ny));
+}
+
+Point GridPlan::getPoint(size_t index) const
+{
+    return Point(xStart + (index%nx)*xStep, yStart + (index/nx)*yStep);
+}
+
+SpiralPlan::shared_pointer SpiralPlan::create(
+    double xCenter, double yCenter,
+    double pitch, size_t pointsPerTurn, size_t npoints)
+{
+    checkCount(pointsPerTurn,"pointsPerTurn");
+    checkCount(npoints,"npoints");
+    return SpiralPlan::shared_pointer(
+        new SpiralPlan(xCenter,yCenter,pitch,pointsPerTurn,npoints));
+}
+
+Point SpiralPlan::getPoint(size_t index) const
+{
+    double turns = double(index)/pointsPerTurn;
+    double radius = pitch*turns;
+    double angle = twoPi*turns;
+    return Point(xCenter + radius*cos(angle), yCenter + radius*sin(angle));
+}
+
+LissajousPlan::shared_pointer LissajousPlan::create(
+    double xCenter, double yCenter,
+    double xAmplitude, double yAmplitude,
+    double xFrequency, double yFrequency,
+    double phase, size_t npoints)
+{
+    checkCount(npoints,"npoints");
+    return LissajousPlan::shared_pointer(
+        new LissajousPlan(xCenter,yCenter,xAmplitude,yAmplitude,
+            xFrequency,yFrequency,phase,npoints));
+}
+
+Point LissajousPlan::getPoint(size_t index) const
+{
+    double t = twoPi*index/npoints;
+    return Point(
+        xCenter + xAmplitude*sin(xFrequency*t + phase),
+        yCenter + yAmplitude*sin(yFrequency*t));
+}
+
+static PVScalarPtr getField(PVStructurePtr const & args, const char * name)
+{
+    PVScalarPtr pvField(args->getSubField<PVScalar>(name));
+    if (!pvField)
+    {
+        std::stringstream ss;
+        ss << "No " << name << " field";
+        throw std::runtime_error(ss.str());
+    }
+    return pvField;
+}
+
+static double getDouble(PVStructurePtr const & args, const char * name)
+{
+    return getField(args,name)->getAs<double>();
+}
+
+static size_t getCount(PVStructurePtr const & args, const char * name)
+{
+    int32 value = getField(args,name)->getAs<int32>();
+    if (value < 0) checkCount(0,name);
+    return value;
+}
+
+ScanPlanPtr createTrajectory(PVStructurePtr const & args)
+{
+    PVStringPtr pvType(args->getSubField<PVString>("type"));
+    if (!pvType) throw std::runtime_error("No type field");
+    string type(pvType->get());
+    if (type=="raster" || type=="serpentine") {
+        return RasterPlan::create(
+            getDouble(args,"xStart"), getDouble(args,"xStop"), getCount(args,"nx"),
+            getDouble(args,"yStart"), getDouble(args,"yStop"), getCount(args,"ny"),
+            type=="serpentine");
+    } else if (type=="grid") {
+        return GridPlan::create(
+            getDouble(args,"xStart"), getDouble(args,"xStep"), getCount(args,"nx"),
+            getDouble(args,"yStart"), getDouble(args,"yStep"), getCount(args,"ny"));
+    } else if (type=="spiral") {
+        return SpiralPlan::create(
+            getDouble(args,"xCenter"), getDouble(args,"yCenter"),
+            getDouble(args,"pitch"), getCount(args,"pointsPerTurn"),
+            getCount(args,"npoints"));
+    } else if (type=="lissajous") {
+        return LissajousPlan::create(
+            getDouble(args,"xCenter"), getDouble(args,"yCenter"),
+            getDouble(args,"xAmplitude"), getDouble(args,"yAmplitude"),
+            getDouble(args,"xFrequency"), getDouble(args,"yFrequency"),
+            getDouble(args,"phase"), getCount(args,"npoints"));
+    }
+    std::stringstream ss;
+    ss << "Unknown trajectory type " << type;
+    throw std::runtime_error(ss.str());
+}
+
+}}
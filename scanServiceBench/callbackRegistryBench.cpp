@@ -0,0 +1,85 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Compare walking the callback registry with copying the callback
+ * vector under a mutex, which is what ScanService::update used to do.
+ * Output is CSV: callbacks,copyNsPerWalk,registryNsPerWalk
+ */
+
+#include <iostream>
+#include <vector>
+#include <epicsTime.h>
+#include <pv/scanService.h>
+#include <pv/callbackRegistry.h>
+
+using namespace std;
+using namespace epics::exampleScan;
+
+class CountingCallback : public ScanService::Callback
+{
+public:
+    CountingCallback() : count(0) {}
+    virtual void update(int flags) { count += flags; }
+    size_t count;
+};
+
+static double walkCopy(
+    std::vector<ScanService::Callback::shared_pointer> const & callbacks,
+    epics::pvData::Mutex & mutex,
+    size_t walks)
+{
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<walks; ++i)
+    {
+        std::vector<ScanService::Callback::shared_pointer> copy;
+        {
+            epics::pvData::Lock lock(mutex);
+            copy = callbacks;
+        }
+        for (size_t j=0; j<copy.size(); ++j) copy[j]->update(1);
+    }
+    return double(epicsMonotonicGet() - start)/walks;
+}
+
+static double walkRegistry(
+    CallbackRegistry<ScanService::Callback::shared_pointer> & registry,
+    size_t walks)
+{
+    typedef CallbackRegistry<ScanService::Callback::shared_pointer>::List List;
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<walks; ++i)
+    {
+        const List & list = registry.acquire();
+        for (List::const_iterator it = list.begin(); it != list.end(); ++it)
+        {
+            (*it)->update(1);
+        }
+        registry.release();
+    }
+    return double(epicsMonotonicGet() - start)/walks;
+}
+
+int main(int argc,char *argv[])
+{
+    cout << "callbacks,copyNsPerWalk,registryNsPerWalk\n";
+    for (size_t ncallbacks = 1; ncallbacks <= 10000; ncallbacks *= 10)
+    {
+        std::vector<ScanService::Callback::shared_pointer> callbacks;
+        epics::pvData::Mutex mutex;
+        CallbackRegistry<ScanService::Callback::shared_pointer> registry;
+        for (size_t i=0; i<ncallbacks; ++i)
+        {
+            ScanService::Callback::shared_pointer callback(new CountingCallback());
+            callbacks.push_back(callback);
+            registry.add(callback);
+        }
+        size_t walks = 1000000/ncallbacks;
+        double copyNs = walkCopy(callbacks,mutex,walks);
+        double registryNs = walkRegistry(registry,walks);
+        cout << ncallbacks << "," << copyNs << "," << registryNs << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Time decoding the argument of the configure RPC method.
+ * lookup   the per point getSubFieldT code ConfigureService used before
+ * cached   PointDecoder with a structure array value field
+ * flat     PointDecoder with double array fields x and y
+ * usage: configureDecodeBench [npoints]
+ * Output is CSV: form,points,seconds,nsPerPoint
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <pv/pvDatabase.h>
+#include <epicsTime.h>
+#include <pv/scanService.h>
+#include <pv/pointDecoder.h>
+
+using namespace std;
+using namespace epics::pvData;
+using namespace epics::exampleScan;
+
+static const int repeats = 3;
+
+// the decoding code of ConfigureService::request before PointDecoder
+static ScanPlanPtr decodeLookup(PVStructurePtr const & args)
+{
+    PVStructureArrayPtr valueField = args->getSubField<PVStructureArray>("value");
+    PVStructureArray::const_svector vals = valueField->view();
+    shared_vector<double> x(vals.size());
+    shared_vector<double> y(vals.size());
+    for (size_t i=0; i<vals.size(); ++i)
+    {
+        x[i] = vals[i]->getSubFieldT<PVDouble>("x")->get();
+        y[i] = vals[i]->getSubFieldT<PVDouble>("y")->get();
+    }
+    return PointListPlan::create(freeze(x),freeze(y));
+}
+
+static PVStructurePtr createValueArgs(size_t npoints)
+{
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    StructureConstPtr pointStructure = fieldCreate->createFieldBuilder()->
+        setId("point_t")->
+        add("x",pvDouble)->
+        add("y",pvDouble)->
+        createStructure();
+    PVStructurePtr args = getPVDataCreate()->createPVStructure(
+        fieldCreate->createFieldBuilder()->
+            addArray("value",pointStructure)->
+            createStructure());
+    PVStructureArray::svector elements(npoints);
+    for (size_t i=0; i<npoints; ++i)
+    {
+        elements[i] = getPVDataCreate()->createPVStructure(pointStructure);
+        elements[i]->getSubFieldT<PVDouble>("x")->put(i*.001);
+        elements[i]->getSubFieldT<PVDouble>("y")->put(-(i*.001));
+    }
+    args->getSubFieldT<PVStructureArray>("value")->replace(freeze(elements));
+    return args;
+}
+
+static PVStructurePtr createFlatArgs(size_t npoints)
+{
+    PVStructurePtr args = getPVDataCreate()->createPVStructure(
+        getFieldCreate()->createFieldBuilder()->
+            addArray("x",pvDouble)->
+            addArray("y",pvDouble)->
+            createStructure());
+    shared_vector<double> x(npoints);
+    shared_vector<double> y(npoints);
+    for (size_t i=0; i<npoints; ++i)
+    {
+        x[i] = i*.001;
+        y[i] = -(i*.001);
+    }
+    args->getSubFieldT<PVDoubleArray>("x")->replace(freeze(x));
+    args->getSubFieldT<PVDoubleArray>("y")->replace(freeze(y));
+    return args;
+}
+
+// best of repeats, so that page faults of the first pass do not count
+static void report(const char * form,size_t npoints,
+    PVStructurePtr const & args,PointDecoderPtr const & decoder)
+{
+    double best = 0.0;
+    for (int i=0; i<repeats; ++i)
+    {
+        epicsUInt64 start = epicsMonotonicGet();
+        ScanPlanPtr plan = decoder ? decoder->decode(args) : decodeLookup(args);
+        double seconds = (epicsMonotonicGet() - start)*1e-9;
+        if (plan->size() != npoints) cerr << form << " decoded " << plan->size() << " points\n";
+        if (i == 0 || seconds < best) best = seconds;
+    }
+    cout << form << "," << npoints << "," << best << "," << best*1e9/npoints << "\n";
+}
+
+int main(int argc,char *argv[])
+{
+    size_t npoints = (argc>1) ? atoi(argv[1]) : 1000000;
+    if (npoints == 0) npoints = 1;
+    PointDecoderPtr decoder = PointDecoder::create();
+    cout << "form,points,seconds,nsPerPoint\n";
+    {
+        PVStructurePtr args = createValueArgs(npoints);
+        report("lookup",npoints,args,PointDecoderPtr());
+        report("cached",npoints,args,decoder);
+    }
+    report("flat",npoints,createFlatArgs(npoints),decoder);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Run many scan services in one process on one executor,
+ * as an IOC with one service per scan record does.
+ * Every service scans a small raster at the same rate.
+ * Each callback sleeps callbackDelay seconds, as a slow subscriber would.
+ * usage: executorBench [records [workers [stepDelay [callbackDelay]]]]
+ * Output is CSV:
+ * records,workers,stepDelay,callbackDelay,seconds,steps,achievedPeriod,jitter,missedDeadlines
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <pv/scanService.h>
+#include <pv/scanExecutor.h>
+#include <pv/trajectory.h>
+
+using namespace std;
+using namespace epics::exampleScan;
+
+class CompletionCallback : public ScanService::Callback
+{
+public:
+    CompletionCallback(size_t & completed,double delay)
+    : completed(completed), delay(delay) {}
+    virtual void update(int flags)
+    {
+        if (delay > 0.0) epicsThreadSleep(delay);
+        if ((flags & SCAN_COMPLETE) != 0) epicsAtomicIncrSizeT(&completed);
+    }
+private:
+    size_t & completed;
+    double delay;
+};
+
+static void run(size_t nrecords,size_t nworkers,double stepDelay,double callbackDelay)
+{
+    ScanExecutorPtr executor(ScanExecutor::create(nworkers,.0001));
+    size_t completed = 0;
+    ScanService::Callback::shared_pointer callback(new CompletionCallback(completed,callbackDelay));
+    vector<ScanServicePtr> services;
+    for (size_t i=0; i<nrecords; ++i)
+    {
+        ScanServicePtr service(ScanService::create(executor));
+        service->registerCallback(callback);
+        service->configure(RasterPlan::create(0.0,.1,5,0.0,.1,5,true));
+        service->setRate(stepDelay,.01);
+        services.push_back(service);
+    }
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<nrecords; ++i) services[i]->startScan();
+    while (epicsAtomicGetSizeT(&completed) < nrecords) epicsThreadSleep(.01);
+    double seconds = (epicsMonotonicGet() - start)*1e-9;
+
+    size_t steps = 0;
+    size_t missed = 0;
+    double period = 0.0;
+    double jitter = 0.0;
+    for (size_t i=0; i<nrecords; ++i)
+    {
+        StepStats stats(services[i]->getStepStats());
+        steps += stats.steps;
+        missed += stats.missedDeadlines;
+        period += stats.achievedPeriod;
+        jitter += stats.jitter;
+    }
+    cout << nrecords << "," << nworkers << "," << stepDelay << "," << callbackDelay << ","
+         << seconds << "," << steps << ","
+         << period/nrecords << "," << jitter/nrecords << "," << missed << "\n";
+}
+
+int main(int argc,char *argv[])
+{
+    size_t nrecords = (argc>1) ? atoi(argv[1]) : 1000;
+    size_t nworkers = (argc>2) ? atoi(argv[2]) : 2;
+    double stepDelay = (argc>3) ? atof(argv[3]) : .001;
+    double callbackDelay = (argc>4) ? atof(argv[4]) : 0.0;
+    cout << "records,workers,stepDelay,callbackDelay,seconds,steps,achievedPeriod,jitter,missedDeadlines\n";
+    run(nrecords,nworkers,stepDelay,callbackDelay);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Compare configure uploads as double arrays with PointCodec streams.
+ * Each plan is materialized into x and y arrays, encoded with scale
+ * 1e-6 and offset 0, decoded and configured into a ScanService.
+ * The transfer time of the upload is estimated for a 1 Gbit/s link.
+ * usage: pointCodecBench [npoints]
+ * Output is CSV:
+ * plan,points,rawBytes,encodedBytes,ratio,encodeSeconds,decodeSeconds,
+ * nsPerPoint,maxError,rawConfigureSeconds,encodedConfigureSeconds
+ * where the configure seconds are link transfer plus server side work.
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <epicsTime.h>
+#include <pv/scanService.h>
+#include <pv/scanExecutor.h>
+#include <pv/scanClock.h>
+#include <pv/trajectory.h>
+#include <pv/pointCodec.h>
+
+using namespace std;
+using namespace epics::pvData;
+using namespace epics::exampleScan;
+
+static const int repeats = 3;
+static const double scale = 1e-6;
+static const double linkBytesPerSecond = 1e9/8;
+
+static double seconds(epicsUInt64 start)
+{
+    return (epicsMonotonicGet() - start)*1e-9;
+}
+
+static void report(const char * name,ScanPlanPtr const & source,ScanServicePtr const & service)
+{
+    size_t npoints = source->size();
+    shared_vector<double> xs(npoints);
+    shared_vector<double> ys(npoints);
+    for (size_t i=0; i<npoints; ++i)
+    {
+        Point point = source->getPoint(i);
+        xs[i] = point.x;
+        ys[i] = point.y;
+    }
+    shared_vector<const double> x(freeze(xs));
+    shared_vector<const double> y(freeze(ys));
+
+    epicsUInt64 start = epicsMonotonicGet();
+    shared_vector<const epicsUInt8> xStream(PointCodec::encode(x,scale,0.0));
+    shared_vector<const epicsUInt8> yStream(PointCodec::encode(y,scale,0.0));
+    double encodeSeconds = seconds(start);
+
+    // best of repeats, so that page faults of the first pass do not count
+    double rawServer = 0.0;
+    double decodeSeconds = 0.0;
+    double encodedServer = 0.0;
+    double maxError = 0.0;
+    for (int r=0; r<repeats; ++r)
+    {
+        start = epicsMonotonicGet();
+        service->configure(PointListPlan::create(x,y));
+        double raw = seconds(start);
+
+        start = epicsMonotonicGet();
+        shared_vector<const double> dx(PointCodec::decode(xStream,npoints,scale,0.0));
+        shared_vector<const double> dy(PointCodec::decode(yStream,npoints,scale,0.0));
+        double decode = seconds(start);
+        service->configure(PointListPlan::create(dx,dy));
+        double encoded = seconds(start);
+
+        if (r == 0 || raw < rawServer) rawServer = raw;
+        if (r == 0 || decode < decodeSeconds) decodeSeconds = decode;
+        if (r == 0 || encoded < encodedServer) encodedServer = encoded;
+        if (r == 0)
+        {
+            for (size_t i=0; i<npoints; ++i)
+            {
+                maxError = max(maxError,fabs(dx[i] - x[i]));
+                maxError = max(maxError,fabs(dy[i] - y[i]));
+            }
+        }
+    }
+    size_t rawBytes = 2*npoints*sizeof(double);
+    size_t encodedBytes = xStream.size() + yStream.size();
+    cout << name << "," << npoints
+         << "," << rawBytes << "," << encodedBytes
+         << "," << double(rawBytes)/encodedBytes
+         << "," << encodeSeconds << "," << decodeSeconds
+         << "," << decodeSeconds*1e9/npoints
+         << "," << maxError
+         << "," << rawBytes/linkBytesPerSecond + rawServer
+         << "," << encodedBytes/linkBytesPerSecond + encodedServer
+         << "\n";
+}
+
+int main(int argc,char *argv[])
+{
+    size_t npoints = (argc>1) ? atoi(argv[1]) : 1000000;
+    if (npoints < 4) npoints = 4;
+    size_t side = static_cast<size_t>(sqrt(double(npoints)));
+    ScanServicePtr service(ScanService::create(
+        ScanExecutor::createVirtual(VirtualClock::create())));
+    cout << "plan,points,rawBytes,encodedBytes,ratio,encodeSeconds,decodeSeconds,"
+         << "nsPerPoint,maxError,rawConfigureSeconds,encodedConfigureSeconds\n";
+    report("raster",RasterPlan::create(0.0,1.0,side,0.0,1.0,side,true),service);
+    report("grid",GridPlan::create(-0.5,0.001,side,-0.5,0.001,side),service);
+    report("spiral",SpiralPlan::create(0.0,0.0,0.001,1000,npoints),service);
+    report("lissajous",LissajousPlan::create(0.0,0.0,1.0,1.0,3.0,4.0,0.0,npoints),service);
+    return 0;
+}
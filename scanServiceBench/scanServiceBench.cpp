@@ -0,0 +1,204 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Benchmarks of the ScanService core, without pvAccess.
+ * throughput  points per second of a scan run in virtual time
+ * jitter      step period and jitter of scans run in real time
+ * configure   cost of configure as a function of the number of points
+ * dispatch    cost of a callback delivery as a function of callbacks
+ * mutex       time a step holds the service mutex
+ * usage: scanServiceBench [csv|json [npoints]]
+ * Each result is one record: benchmark,parameter,metric,value
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <pv/scanService.h>
+#include <pv/scanExecutor.h>
+#include <pv/scanClock.h>
+#include <pv/trajectory.h>
+
+using namespace std;
+using namespace epics::exampleScan;
+
+struct Result
+{
+    Result(const string & benchmark,double parameter,const string & metric,double value)
+    : benchmark(benchmark), parameter(parameter), metric(metric), value(value) {}
+    string benchmark;
+    double parameter;
+    string metric;
+    double value;
+};
+
+static vector<Result> results;
+
+static void add(const string & benchmark,double parameter,const string & metric,double value)
+{
+    results.push_back(Result(benchmark,parameter,metric,value));
+}
+
+static double seconds(epicsUInt64 start)
+{
+    return (epicsMonotonicGet() - start)*1e-9;
+}
+
+class CountingCallback : public ScanService::Callback
+{
+public:
+    CountingCallback() : completed(0), updates(0) {}
+    virtual void update(int flags)
+    {
+        epicsAtomicIncrSizeT(&updates);
+        if ((flags & SCAN_COMPLETE) != 0) epicsAtomicSetIntT(&completed,1);
+    }
+    bool isComplete() { return epicsAtomicGetIntT(&completed) != 0; }
+    size_t getUpdates() { return epicsAtomicGetSizeT(&updates); }
+private:
+    int completed;
+    size_t updates;
+};
+
+// each point is reached in one step, so a scan of n points takes n+1 steps
+static ScanServicePtr createService(ScanExecutorPtr const & executor,
+    ScanPlanPtr const & plan,double stepDelay,size_t ncallbacks,
+    std::tr1::shared_ptr<CountingCallback> & completion)
+{
+    ScanServicePtr service(ScanService::create(executor));
+    completion = std::tr1::shared_ptr<CountingCallback>(new CountingCallback());
+    service->registerCallback(completion);
+    for (size_t i=1; i<ncallbacks; ++i)
+    {
+        service->registerCallback(ScanService::Callback::shared_pointer(new CountingCallback()));
+    }
+    service->configure(plan);
+    service->setRate(stepDelay,1e6);
+    return service;
+}
+
+static double runVirtual(ScanPlanPtr const & plan,size_t ncallbacks,StepStats & stats)
+{
+    ScanExecutorPtr executor(ScanExecutor::createVirtual(VirtualClock::create()));
+    std::tr1::shared_ptr<CountingCallback> completion;
+    ScanServicePtr service(createService(executor,plan,.001,ncallbacks,completion));
+    epicsUInt64 start = epicsMonotonicGet();
+    service->startScan();
+    while (!completion->isComplete() && executor->runNext()) {}
+    double wall = seconds(start);
+    stats = service->getStepStats();
+    return wall;
+}
+
+static void throughput(size_t npoints)
+{
+    StepStats stats;
+    ScanPlanPtr plan(SpiralPlan::create(0.0,0.0,.01,100,npoints));
+    double wall = runVirtual(plan,1,stats);
+    add("throughput",npoints,"pointsPerSecond",npoints/wall);
+    add("throughput",npoints,"stepsPerSecond",stats.steps/wall);
+    add("mutex",npoints,"meanHoldTime",stats.meanHoldTime);
+    add("mutex",npoints,"maxHoldTime",stats.maxHoldTime);
+}
+
+static void jitter(double stepDelay)
+{
+    ScanExecutorPtr executor(ScanExecutor::create(1,.0001));
+    std::tr1::shared_ptr<CountingCallback> completion;
+    size_t npoints = static_cast<size_t>(.5/stepDelay);
+    ScanServicePtr service(createService(executor,
+        RasterPlan::create(0.0,1.0,npoints,0.0,0.0,1,false),stepDelay,1,completion));
+    service->startScan();
+    while (!completion->isComplete()) epicsThreadSleep(.01);
+    StepStats stats(service->getStepStats());
+    add("jitter",stepDelay,"achievedPeriod",stats.achievedPeriod);
+    add("jitter",stepDelay,"jitter",stats.jitter);
+    add("jitter",stepDelay,"maxLateness",stats.maxLateness);
+    add("jitter",stepDelay,"missedDeadlines",stats.missedDeadlines);
+    add("jitter",stepDelay,"startLatency",stats.startLatency);
+    add("jitter",stepDelay,"meanHoldTime",stats.meanHoldTime);
+}
+
+static void configure(size_t npoints)
+{
+    ScanServicePtr service(ScanService::create(
+        ScanExecutor::createVirtual(VirtualClock::create())));
+    vector<Point> points(npoints);
+    for (size_t i=0; i<npoints; ++i) points[i] = Point(i*.001,i*.002);
+    ScanPlanPtr plan(PointListPlan::create(points));
+    size_t repeat = 1 + 1000000/npoints;
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<repeat; ++i) service->configure(points);
+    double copied = seconds(start)/repeat;
+    start = epicsMonotonicGet();
+    for (size_t i=0; i<repeat; ++i) service->configure(plan);
+    double shared = seconds(start)/repeat;
+    add("configure",npoints,"pointsSeconds",copied);
+    add("configure",npoints,"pointsNsPerPoint",copied*1e9/npoints);
+    add("configure",npoints,"planSeconds",shared);
+}
+
+static void dispatch(size_t npoints,size_t ncallbacks,double baseline)
+{
+    StepStats stats;
+    ScanPlanPtr plan(SpiralPlan::create(0.0,0.0,.01,100,npoints));
+    double wall = runVirtual(plan,ncallbacks,stats);
+    // every step changes the readback and posts one notification
+    add("dispatch",ncallbacks,"seconds",wall);
+    if (ncallbacks > 1)
+    {
+        add("dispatch",ncallbacks,"nsPerCallback",
+            (wall - baseline)*1e9/(stats.steps*(ncallbacks - 1)));
+    }
+}
+
+static void print(bool json)
+{
+    if (json) cout << "[\n";
+    else cout << "benchmark,parameter,metric,value\n";
+    for (size_t i=0; i<results.size(); ++i)
+    {
+        const Result & r = results[i];
+        if (json)
+        {
+            cout << "  {\"benchmark\":\"" << r.benchmark
+                 << "\",\"parameter\":" << r.parameter
+                 << ",\"metric\":\"" << r.metric
+                 << "\",\"value\":" << r.value << "}"
+                 << ((i+1 < results.size()) ? ",\n" : "\n");
+        }
+        else
+        {
+            cout << r.benchmark << "," << r.parameter << ","
+                 << r.metric << "," << r.value << "\n";
+        }
+    }
+    if (json) cout << "]\n";
+}
+
+int main(int argc,char *argv[])
+{
+    bool json = (argc>1) && strcmp(argv[1],"json")==0;
+    size_t npoints = (argc>2) ? atoi(argv[2]) : 100000;
+
+    throughput(npoints);
+    jitter(.01);
+    jitter(.001);
+    for (size_t n=10; n<=1000000; n*=10) configure(n);
+    StepStats stats;
+    ScanPlanPtr plan(SpiralPlan::create(0.0,0.0,.01,100,npoints));
+    double baseline = runVirtual(plan,1,stats);
+    dispatch(npoints,1,baseline);
+    dispatch(npoints,10,baseline);
+    dispatch(npoints,100,baseline);
+    print(json);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Compare the stepToward kernel with the scalar x/y code that
+ * ScanService::run used before, and time the kernel for more axes.
+ * Output is CSV: kernel,axes,nsPerStep
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <epicsTime.h>
+#include <pv/scanService.h>
+#include <pv/scanKernel.h>
+
+using namespace std;
+using namespace epics::exampleScan;
+
+static const size_t ntargets = 1000;
+static const double stepDistance = .01;
+
+// the stepping code of ScanService::run before stepToward
+static bool scalarStep(const Point & positionSP, Point & positionRB)
+{
+    double dx = positionSP.x - positionRB.x;
+    double dy = positionSP.y - positionRB.y;
+    double absx = fabs(dx);
+    double del = stepDistance*.01;
+    if(absx<=(stepDistance+del)) dx = 0.0;
+    double absy = fabs(dy);
+    if(absy<=(stepDistance+del)) dy = 0.0;
+    if(dx==0.0 && dy==0.0) {
+        positionRB = positionSP;
+        return true;
+    }
+    bool dxLarger = (absx>absy) ? true : false;
+    if(dx!=0.0) {
+        if(dx>0.0) {dx = stepDistance;} else {dx = -stepDistance;}
+        if(!dxLarger && dy!=0.0) dx = dx*(absx/absy);
+    }
+    if(dy!=0.0) {
+        if(dy>0.0) {dy = stepDistance;} else {dy = -stepDistance;}
+        if(dxLarger && dx!=0.0) dy = dy*(absy/absx);
+    }
+    positionRB = Point(positionRB.x + dx, positionRB.y + dy);
+    return false;
+}
+
+static double randomCoordinate()
+{
+    return (rand()%2000)*.001 - 1.0;
+}
+
+static double benchScalar(size_t & steps)
+{
+    srand(1);
+    vector<Point> targets;
+    for (size_t i=0; i<ntargets; ++i)
+        targets.push_back(Point(randomCoordinate(),randomCoordinate()));
+    Point rb;
+    steps = 0;
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<ntargets; ++i)
+    {
+        while (true) { ++steps; if (scalarStep(targets[i],rb)) break; }
+    }
+    return double(epicsMonotonicGet() - start)/steps;
+}
+
+template<size_t D>
+static double benchKernel(size_t & steps)
+{
+    srand(1);
+    vector<PointN<D> > targets(ntargets);
+    for (size_t i=0; i<ntargets; ++i)
+        for (size_t j=0; j<D; ++j) targets[i][j] = randomCoordinate();
+    PointN<D> rb;
+    steps = 0;
+    epicsUInt64 start = epicsMonotonicGet();
+    for (size_t i=0; i<ntargets; ++i)
+    {
+        while (true) { ++steps; if (stepToward(targets[i],rb,stepDistance)) break; }
+    }
+    return double(epicsMonotonicGet() - start)/steps;
+}
+
+// the kernel must produce the same trajectory as the scalar code
+static size_t countMismatches()
+{
+    srand(2);
+    size_t mismatches = 0;
+    Point rb;
+    PointN<2> rbN;
+    for (size_t i=0; i<ntargets; ++i)
+    {
+        Point sp(randomCoordinate(),randomCoordinate());
+        PointN<2> spN;
+        spN[0] = sp.x;
+        spN[1] = sp.y;
+        while (true)
+        {
+            bool done = scalarStep(sp,rb);
+            bool doneN = stepToward(spN,rbN,stepDistance);
+            if (done != doneN || rb.x != rbN[0] || rb.y != rbN[1])
+            {
+                ++mismatches;
+                rbN[0] = rb.x;
+                rbN[1] = rb.y;
+            }
+            if (done) break;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc,char *argv[])
+{
+    size_t steps = 0;
+    cerr << "mismatches " << countMismatches() << "\n";
+    cout << "kernel,axes,nsPerStep\n";
+    double ns = benchScalar(steps);
+    cout << "scalar,2," << ns << "\n";
+    ns = benchKernel<2>(steps);
+    cout << "stepToward,2," << ns << "\n";
+    ns = benchKernel<3>(steps);
+    cout << "stepToward,3," << ns << "\n";
+    ns = benchKernel<4>(steps);
+    cout << "stepToward,4," << ns << "\n";
+    ns = benchKernel<6>(steps);
+    cout << "stepToward,6," << ns << "\n";
+    return 0;
+}
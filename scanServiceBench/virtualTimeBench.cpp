@@ -0,0 +1,172 @@
+/*
+ * Copyright information and license terms for this software can be
+ * found in the file LICENSE that is included with the distribution
+ */
+
+/**
+ * Run a scan on a virtual executor and compare it with the same scan
+ * run in real time.
+ * First a short raster is run both ways and the sequences of updates,
+ * flags and positions, are compared. They are recorded by a post observer,
+ * before the dispatcher merges them, since how many updates a callback
+ * sees merged depends on timing.
+ * Then a scan of npoints is run in virtual time only.
+ * usage: virtualTimeBench [npoints [stepDelay]]
+ * Output is CSV:
+ * mode,points,updates,callbacks,virtualSeconds,wallSeconds,speedup
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <pv/scanService.h>
+#include <pv/scanExecutor.h>
+#include <pv/scanClock.h>
+#include <pv/trajectory.h>
+
+using namespace std;
+using namespace epics::exampleScan;
+
+struct Event
+{
+    int flags;
+    Point setpoint;
+    Point readback;
+};
+
+// records every update as it is posted, on the thread that steps
+class PostRecorder : public ScanService::Callback
+{
+public:
+    POINTER_DEFINITIONS(PostRecorder);
+    void setService(ScanServicePtr const & value) { service = value; }
+    virtual void update(int flags)
+    {
+        ScanSnapshot snapshot(service.lock()->getSnapshot());
+        Event event;
+        event.flags = flags;
+        event.setpoint = snapshot.setpoint;
+        event.readback = snapshot.readback;
+        events.push_back(event);
+    }
+    vector<Event> events;
+private:
+    ScanService::weak_pointer service;
+};
+
+// counts the callbacks, which may be merged updates
+class CompletionCallback : public ScanService::Callback
+{
+public:
+    POINTER_DEFINITIONS(CompletionCallback);
+    CompletionCallback() : callbacks(0), completed(0) {}
+    virtual void update(int flags)
+    {
+        epicsAtomicIncrSizeT(&callbacks);
+        if ((flags & SCAN_COMPLETE) != 0) epicsAtomicSetIntT(&completed,1);
+    }
+    bool isComplete() { return epicsAtomicGetIntT(&completed) != 0; }
+    size_t getCallbacks() { return epicsAtomicGetSizeT(&callbacks); }
+private:
+    size_t callbacks;
+    int completed;
+};
+
+struct Run
+{
+    ScanServicePtr service;
+    PostRecorder::shared_pointer recorder;
+    CompletionCallback::shared_pointer callback;
+};
+
+static void startScan(
+    ScanExecutorPtr const & executor,ScanPlanPtr const & plan,
+    double stepDelay,Run & run)
+{
+    run.service = ScanService::create(executor);
+    run.recorder = PostRecorder::shared_pointer(new PostRecorder());
+    run.recorder->setService(run.service);
+    run.service->setPostObserver(run.recorder);
+    run.callback = CompletionCallback::shared_pointer(new CompletionCallback());
+    run.service->registerCallback(run.callback);
+    run.service->configure(plan);
+    run.service->setRate(stepDelay,.01);
+    run.service->startScan();
+}
+
+static void runVirtual(
+    ScanPlanPtr const & plan,double stepDelay,Run & run,double & virtualSeconds)
+{
+    VirtualClockPtr clock(VirtualClock::create());
+    ScanExecutorPtr executor(ScanExecutor::createVirtual(clock));
+    startScan(executor,plan,stepDelay,run);
+    epicsUInt64 start = clock->now();
+    while (!run.callback->isComplete() && executor->runNext()) {}
+    virtualSeconds = (clock->now() - start)*1e-9;
+}
+
+static void runReal(ScanPlanPtr const & plan,double stepDelay,Run & run)
+{
+    ScanExecutorPtr executor(ScanExecutor::create(1,.0001));
+    startScan(executor,plan,stepDelay,run);
+    while (!run.callback->isComplete()) epicsThreadSleep(.01);
+}
+
+static bool same(vector<Event> const & a,vector<Event> const & b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i=0; i<a.size(); ++i)
+    {
+        if (a[i].flags != b[i].flags) return false;
+        if (a[i].setpoint != b[i].setpoint) return false;
+        if (a[i].readback != b[i].readback) return false;
+    }
+    return true;
+}
+
+int main(int argc,char *argv[])
+{
+    size_t npoints = (argc>1) ? atoi(argv[1]) : 10000;
+    double stepDelay = (argc>2) ? atof(argv[2]) : .001;
+
+    ScanPlanPtr raster(RasterPlan::create(0.0,.05,3,0.0,.05,3,true));
+    double virtualSeconds = 0.0;
+    Run real;
+    epicsUInt64 start = epicsMonotonicGet();
+    runReal(raster,stepDelay,real);
+    double realSeconds = (epicsMonotonicGet() - start)*1e-9;
+    Run simulated;
+    start = epicsMonotonicGet();
+    runVirtual(raster,stepDelay,simulated,virtualSeconds);
+    double wallSeconds = (epicsMonotonicGet() - start)*1e-9;
+    bool identical = same(real.recorder->events,simulated.recorder->events);
+
+    cout << "mode,points,updates,callbacks,virtualSeconds,wallSeconds,speedup\n";
+    cout << "real," << raster->size() << "," << real.recorder->events.size() << ","
+         << real.callback->getCallbacks() << ","
+         << realSeconds << "," << realSeconds << ",1\n";
+    cout << "virtual," << raster->size() << "," << simulated.recorder->events.size() << ","
+         << simulated.callback->getCallbacks() << ","
+         << virtualSeconds << "," << wallSeconds << ","
+         << virtualSeconds/wallSeconds << "\n";
+
+    ScanPlanPtr spiral(SpiralPlan::create(0.0,0.0,.01,100,npoints));
+    Run big;
+    start = epicsMonotonicGet();
+    runVirtual(spiral,stepDelay,big,virtualSeconds);
+    wallSeconds = (epicsMonotonicGet() - start)*1e-9;
+    cout << "virtual," << npoints << "," << big.recorder->events.size() << ","
+         << big.callback->getCallbacks() << ","
+         << virtualSeconds << "," << wallSeconds << ","
+         << virtualSeconds/wallSeconds << "\n";
+
+    if (!identical)
+    {
+        cerr << "virtual and real update sequences differ\n";
+        return 1;
+    }
+    return 0;
+}